@@ -0,0 +1,224 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "trcf.hpp"
+#include "trcfapi.h"
+
+/**
+ * Compare the C string API with the C++ template front-end.
+ * The C path records the time of every cache probe (ct_gettime, for
+ * trcf_best_guess_size), the template keeps no such bookkeeping.
+ * */
+
+#define U64_KEYS (1 << 20)
+
+#define REPEAT 5
+
+struct pow2_config : trcf::default_config {
+    static constexpr bool power_of_two = true;
+};
+
+static double now_ns() {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char * name, const char * op, double ns, std::size_t ops, std::size_t hits) {
+    std::printf("%-36s %-12s %8.2f ns/op %8.2f Mops/s  hits %zu\n",
+                name, op, ns / ops, ops * 1000.0 / ns, hits);
+}
+
+/* Insert the first half of keys, then look up all keys REPEAT times */
+template <typename AddIfNew, typename Contains>
+static void bench(const char * name, const std::vector<std::string_view> & keys,
+                  AddIfNew add_if_new, Contains contains) {
+    std::size_t half = keys.size() / 2, hits = 0;
+    double t0 = now_ns();
+    for (std::size_t i = 0; i < half; i++) {
+        hits += add_if_new(keys[i]);
+    }
+    report(name, "add_if_new", now_ns() - t0, half, hits);
+    hits = 0;
+    t0 = now_ns();
+    for (int r = 0; r < REPEAT; r++) {
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            hits += contains(keys[i]);
+        }
+    }
+    report(name, "contains", now_ns() - t0, REPEAT * keys.size(), hits);
+}
+
+template <typename Filter>
+static void bench_batch(const char * name, const std::vector<std::string_view> & keys, Filter & f) {
+    std::size_t half = keys.size() / 2, hits = 0;
+    std::unique_ptr<bool[]> out(new bool[keys.size()]);
+    std::span<const std::string_view> all(keys);
+    double t0 = now_ns();
+    f.add_if_new(all.first(half), std::span<bool>(out.get(), half));
+    for (std::size_t i = 0; i < half; i++) {
+        hits += out[i];
+    }
+    report(name, "add_if_new", now_ns() - t0, half, hits);
+    hits = 0;
+    t0 = now_ns();
+    for (int r = 0; r < REPEAT; r++) {
+        f.contains(all, std::span<bool>(out.get(), keys.size()));
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            hits += out[i];
+        }
+    }
+    report(name, "contains", now_ns() - t0, REPEAT * keys.size(), hits);
+}
+
+template <typename AddIfNew, typename Contains>
+static void bench_ids(const char * name, const std::vector<uint64_t> & ids,
+                      AddIfNew add_if_new, Contains contains) {
+    std::size_t half = ids.size() / 2, hits = 0;
+    double t0 = now_ns();
+    for (std::size_t i = 0; i < half; i++) {
+        hits += add_if_new(ids[i]);
+    }
+    report(name, "add_if_new", now_ns() - t0, half, hits);
+    hits = 0;
+    t0 = now_ns();
+    for (int r = 0; r < REPEAT; r++) {
+        for (std::size_t i = 0; i < ids.size(); i++) {
+            hits += contains(ids[i]);
+        }
+    }
+    report(name, "contains", now_ns() - t0, REPEAT * ids.size(), hits);
+}
+
+static void bench_ids_remove(const char * name, const std::vector<uint64_t> & ids, time_rotated_cache_filter_t * c) {
+    std::size_t half = ids.size() / 2, hits = 0;
+    double t0 = now_ns();
+    for (std::size_t i = 0; i < half; i++) {
+        hits += trcf_remove_item_u64(c, ids[i]);
+    }
+    report(name, "remove", now_ns() - t0, half, hits);
+}
+
+static void bench_ids_batch(const char * name, const std::vector<uint64_t> & ids, time_rotated_cache_filter_t * c) {
+    std::size_t half = ids.size() / 2, hits = 0;
+    std::vector<int> out(ids.size());
+    double t0 = now_ns();
+    trcf_add_if_new_batch_u64(c, ids.data(), half, out.data());
+    for (std::size_t i = 0; i < half; i++) {
+        hits += out[i];
+    }
+    report(name, "add_if_new", now_ns() - t0, half, hits);
+    hits = 0;
+    t0 = now_ns();
+    for (int r = 0; r < REPEAT; r++) {
+        trcf_contains_batch_u64(c, ids.data(), ids.size(), out.data());
+        for (std::size_t i = 0; i < ids.size(); i++) {
+            hits += out[i];
+        }
+    }
+    report(name, "contains", now_ns() - t0, REPEAT * ids.size(), hits);
+    hits = 0;
+    t0 = now_ns();
+    trcf_remove_batch_u64(c, ids.data(), half, out.data());
+    for (std::size_t i = 0; i < half; i++) {
+        hits += out[i];
+    }
+    report(name, "remove", now_ns() - t0, half, hits);
+}
+
+static void count_hit(void * tag, int found) {
+    *(std::size_t *)tag += found;
+}
+
+/* One key submitted at a time through the lookup engine */
+static void bench_ids_engine(const char * name, const std::vector<uint64_t> & ids, time_rotated_cache_filter_t * c) {
+    std::size_t half = ids.size() / 2, hits = 0;
+    std::vector<int> out(ids.size());
+    lookup_engine_t * le = new_lookup_engine(c, count_hit);
+    trcf_add_if_new_batch_u64(c, ids.data(), half, out.data());
+    double t0 = now_ns();
+    for (int r = 0; r < REPEAT; r++) {
+        for (std::size_t i = 0; i < ids.size(); i++) {
+            le_submit_u64(le, ids[i], &hits);
+        }
+        le_drain(le);
+    }
+    report(name, "contains", now_ns() - t0, REPEAT * ids.size(), hits);
+    remove_lookup_engine(le);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s <words_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::fprintf(stderr, "ERROR: Could not open words file\n");
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> words;
+    for (std::string line; std::getline(in, line); ) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        words.push_back(line);
+    }
+    std::vector<std::string_view> keys(words.begin(), words.end());
+    /* Size every filter so the inserted half stays in a single generation at 25% load */
+    uint64_t size_k = 2 * keys.size();
+    std::printf("Keys: %zu (half inserted), size_k %llu\n", keys.size(), (unsigned long long)size_k);
+    std::printf("Note: C lookups also record a clock_gettime per cache probed, C++ lookups don't\n");
+
+    time_rotated_cache_filter_t * c = new_time_rotated_cache_filter(size_k);
+    bench("C trcf_*", keys,
+          [&](std::string_view k) { return trcf_add_if_new(c, k.data(), k.size()); },
+          [&](std::string_view k) { return trcf_contains_item(c, k.data(), k.size()); });
+    remove_time_rotated_cache_filter(c);
+
+    /* 64 bit ids through the string API (8 byte keys) and the u64 fast path */
+    std::vector<uint64_t> ids(U64_KEYS);
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        ids[i] = i * 0x9e3779b97f4a7c15llu;
+    }
+    std::printf("Ids: %zu (half inserted), size_k %llu\n", ids.size(), (unsigned long long)(2 * ids.size()));
+    c = new_time_rotated_cache_filter(2 * ids.size());
+    bench_ids("C trcf_* (8 byte string)", ids,
+              [&](uint64_t k) { return trcf_add_if_new(c, (const char *)&k, sizeof(k)); },
+              [&](uint64_t k) { return trcf_contains_item(c, (const char *)&k, sizeof(k)); });
+    remove_time_rotated_cache_filter(c);
+    c = new_time_rotated_cache_filter(2 * ids.size());
+    bench_ids("C trcf_*_u64", ids,
+              [&](uint64_t k) { return trcf_add_if_new_u64(c, k); },
+              [&](uint64_t k) { return trcf_contains_item_u64(c, k); });
+    bench_ids_remove("C trcf_*_u64", ids, c);
+    remove_time_rotated_cache_filter(c);
+    c = new_time_rotated_cache_filter(2 * ids.size());
+    bench_ids_batch("C trcf_*_batch_u64", ids, c);
+    remove_time_rotated_cache_filter(c);
+    c = new_time_rotated_cache_filter(2 * ids.size());
+    bench_ids_engine("C le_submit_u64", ids, c);
+    remove_time_rotated_cache_filter(c);
+
+    trcf::filter<> f1(size_k);
+    bench("C++ filter<uint64_t, 1>", keys,
+          [&](std::string_view k) { return f1.add_if_new(k); },
+          [&](std::string_view k) { return f1.contains(k); });
+
+    trcf::filter<uint64_t, 4, trcf::murmur3_128, pow2_config> f4(size_k / 4);
+    bench("C++ filter<uint64_t, 4, pow2>", keys,
+          [&](std::string_view k) { return f4.add_if_new(k); },
+          [&](std::string_view k) { return f4.contains(k); });
+
+    trcf::filter<> fb1(size_k);
+    bench_batch("C++ filter<uint64_t, 1> batch", keys, fb1);
+
+    trcf::filter<uint64_t, 4, trcf::murmur3_128, pow2_config> fb4(size_k / 4);
+    bench_batch("C++ filter<uint64_t, 4, pow2> batch", keys, fb4);
+    return EXIT_SUCCESS;
+}
@@ -7,6 +7,14 @@
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void MurmurHash3_x64_128 ( const void * key, int len, uint32_t seed, void * out );
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // _MURMURHASH3_H_
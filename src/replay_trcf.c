@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "trcf.h"
+
+/**
+ * Replay a trace recorded with trcf_trace_start against the filter as compiled,
+ * and print one result row. Build once per set of constants to compare
+ * configurations, see `make replay`.
+ * */
+
+#ifndef REPLAY_CONFIG
+#define REPLAY_CONFIG "default"
+#endif
+
+/* Virtual clock driven by the trace timestamps */
+static uint64_t replay_now;
+
+static uint64_t replay_clock(void) {
+    return replay_now;
+}
+
+static uint64_t wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec*1000000000llu+ts.tv_nsec);
+}
+
+/**
+ * Exact set of added hashes, used as ground truth for false negatives.
+ * Open addressing, hh[1] == 0 marks an empty slot.
+ * */
+typedef struct {
+    uint64_t mask;
+    uint64_t (*slots)[2];
+} exact_set_t;
+
+static int exact_set_init(exact_set_t * es, size_t n) {
+    uint64_t size = 1024;
+    while (size < 2*n) {
+        size <<= 1;
+    }
+    es->mask = size - 1;
+    return (es->slots = calloc(size, sizeof(*es->slots))) != NULL;
+}
+
+static uint64_t * exact_set_find(exact_set_t * es, uint64_t hh[2]) {
+    uint64_t ind = hh[0] & es->mask;
+    while (es->slots[ind][1] != 0 &&
+            (es->slots[ind][0] != hh[0] || es->slots[ind][1] != hh[1])) {
+        ind = (ind + 1) & es->mask;
+    }
+    return es->slots[ind];
+}
+
+/* Returns 1 if hh was already present */
+static int exact_set_add(exact_set_t * es, uint64_t hh[2]) {
+    uint64_t * slot = exact_set_find(es, hh);
+    if (slot[1] != 0) {
+        return 1;
+    }
+    slot[0] = hh[0];
+    slot[1] = hh[1];
+    return 0;
+}
+
+static int exact_set_contains(exact_set_t * es, uint64_t hh[2]) {
+    return exact_set_find(es, hh)[1] != 0;
+}
+
+/* Returns 1 if hh was present. Later entries of the probe run are shifted back */
+static int exact_set_remove(exact_set_t * es, uint64_t hh[2]) {
+    uint64_t * slot = exact_set_find(es, hh);
+    uint64_t i, j, home;
+    if (slot[1] == 0) {
+        return 0;
+    }
+    i = (slot - es->slots[0]) / 2;
+    for (j = (i + 1) & es->mask; es->slots[j][1] != 0; j = (j + 1) & es->mask) {
+        home = es->slots[j][0] & es->mask;
+        /* Move j into the hole at i unless its home lies cyclically in (i, j] */
+        if (((j - home) & es->mask) >= ((j - i) & es->mask)) {
+            es->slots[i][0] = es->slots[j][0];
+            es->slots[i][1] = es->slots[j][1];
+            i = j;
+        }
+    }
+    es->slots[i][0] = 0;
+    es->slots[i][1] = 0;
+    return 1;
+}
+
+static trace_record_t * load_trace(const char * path, size_t * n, uint64_t * start_time, uint64_t * size_k) {
+    trace_t * tr;
+    trace_record_t * recs = NULL, * tmp;
+    size_t siz = 0, got;
+    *n = 0;
+    if ((tr = open_trace(path)) == NULL) {
+        return NULL;
+    }
+    *start_time = tr->start_time;
+    *size_k = tr->size_k;
+    do {
+        if (*n == siz) {
+            siz = (siz ? 2*siz : TRACE_BUF_SIZ);
+            if ((tmp = realloc(recs, siz*sizeof(trace_record_t))) == NULL) {
+                free(recs);
+                remove_trace(tr);
+                return NULL;
+            }
+            recs = tmp;
+        }
+        got = trace_read(tr, recs + *n, siz - *n);
+        *n += got;
+    } while (got > 0);
+    remove_trace(tr);
+    return recs;
+}
+
+static void print_header(void) {
+    printf("%-96s %10s %10s %12s %12s %8s %9s %7s %7s\n",
+           "config", "ops", "Mops/s", "mem_bytes", "peak_bytes", "fp", "fn_rate", "rotates", "caches");
+}
+
+int main(int argc, char *argv[]) {
+    time_rotated_cache_filter_t * trcf;
+    trace_record_t * recs;
+    uint8_t * results;
+    exact_set_t truth;
+    uint64_t start_time, t0, t1, memory, peak;
+    uint64_t positives = 0, false_negatives = 0, false_positives = 0;
+    uint64_t hh[2];
+    uint32_t idx;
+    size_t i, n;
+    uint64_t size_k, trace_size_k;
+
+    if (argc == 2 && strcmp(argv[1], "--header") == 0) {
+        print_header();
+        return EXIT_SUCCESS;
+    }
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <trace_file> [initial size_k, default as recorded]\n"
+                        "       %s --header\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    if ((recs = load_trace(argv[1], &n, &start_time, &trace_size_k)) == NULL) {
+        fprintf(stderr, "ERROR: Could not read trace file\n");
+        return EXIT_FAILURE;
+    }
+    size_k = (argc == 3 ? strtoull(argv[2], NULL, 10) : trace_size_k);
+    if ((results = malloc(n + 1)) == NULL || !exact_set_init(&truth, n)) {
+        fprintf(stderr, "ERROR: Could not allocate replay state\n");
+        return EXIT_FAILURE;
+    }
+
+    trcf_set_clock(replay_clock);
+    replay_now = start_time + (n ? TRACE_TIME(&recs[0]) : 0);
+    if ((trcf = new_time_rotated_cache_filter(size_k)) == NULL) {
+        fprintf(stderr, "ERROR: Could not create filter\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Timed pass: filter only, results are scored afterwards */
+    peak = memory = trcf_total_memory(trcf);
+    idx = trcf->idx;
+    t0 = wall_time();
+    for (i = 0; i < n; i++) {
+        replay_now = start_time + TRACE_TIME(&recs[i]);
+        /* Adds may overwrite the hash on replacement, keep the record intact for scoring */
+        hh[0] = recs[i].hh[0];
+        hh[1] = recs[i].hh[1];
+        switch (TRACE_OP(&recs[i])) {
+            case TRACE_ADD:
+                trcf_add_hash(trcf, hh);
+                break;
+            case TRACE_CONTAINS:
+                results[i] = trcf_contains_hash(trcf, hh);
+                break;
+            case TRACE_ADD_IF_NEW:
+                results[i] = trcf_add_hash_if_new(trcf, hh);
+                break;
+            case TRACE_REMOVE:
+                results[i] = trcf_remove_hash(trcf, hh);
+                break;
+        }
+        if (trcf->idx != idx) {
+            idx = trcf->idx;
+            memory = trcf_total_memory(trcf);
+            peak = max(peak, memory);
+        }
+    }
+    t1 = wall_time();
+
+    /* Score against the exact set of everything added so far */
+    for (i = 0; i < n; i++) {
+        switch (TRACE_OP(&recs[i])) {
+            case TRACE_ADD:
+                exact_set_add(&truth, recs[i].hh);
+                break;
+            case TRACE_CONTAINS:
+                if (exact_set_contains(&truth, recs[i].hh)) {
+                    positives++;
+                    false_negatives += !results[i];
+                } else {
+                    false_positives += results[i];
+                }
+                break;
+            case TRACE_ADD_IF_NEW:
+                if (exact_set_add(&truth, recs[i].hh)) {
+                    positives++;
+                    false_negatives += results[i];
+                } else {
+                    false_positives += !results[i];
+                }
+                break;
+            case TRACE_REMOVE:
+                if (exact_set_remove(&truth, recs[i].hh)) {
+                    positives++;
+                    false_negatives += !results[i];
+                } else {
+                    false_positives += results[i];
+                }
+                break;
+        }
+    }
+
+    printf("%-96s %10zu %10.2f %12llu %12llu %8llu %9.6f %7u %7u\n",
+           REPLAY_CONFIG,
+           n,
+           (t1 > t0 ? (double)n*1000/(t1 - t0) : 0.0),
+           (unsigned long long)memory,
+           (unsigned long long)peak,
+           (unsigned long long)false_positives,
+           (positives ? (double)false_negatives/positives : 0.0),
+           trcf->idx - 1,
+           min(trcf->idx, trcf->siz));
+
+    remove_time_rotated_cache_filter(trcf);
+    free(truth.slots);
+    free(results);
+    free(recs);
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
@@ -11,6 +12,7 @@
 
 #define CAPACITY 8192*2
 #define ERROR_RATE .01
+#define TRACE_TEST_FILE "test_trace.bin"
 
 enum {
     TEST_PASS,
@@ -57,7 +59,7 @@ static void print_trcf_stat(time_rotated_cache_filter_t * trcf) {
            min(trcf->idx, trcf->siz),
            trcf_total_size_k(trcf),
            sizeof(SIZE_N),
-           sizeof(SIZE_N)*trcf_total_size_k(trcf)
+           trcf_total_memory(trcf)
            );
 }
 
@@ -164,6 +166,97 @@ int test_cc(const char *words_file) {
     return print_results(&results);
 }
 
+static uint64_t test_gettime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec*1000000000llu+ts.tv_nsec);
+}
+
+/* Fill a cache to 50% with the random walk and with BFS insertion and compare */
+int test_cc_insert_modes(const char *words_file) {
+    uint64_t * (*add[2])(cache_t *, uint64_t *) = { cc_add_item, cc_add_item_bfs };
+    const char * names[2] = { "walk", "bfs" };
+    static uint64_t hashes[CAPACITY][2];
+    static int failed[CAPACITY];
+    time_rotated_cache_filter_t * trcf;
+    cache_t * cc;
+    int i, m, first_fail, failures, lost, lost_bfs = 0;
+    char word[256];
+    FILE *fp;
+    uint64_t hh[2], t0, t1;
+    printf("\n** Testing Cuckoo Cache Insert Modes \n");
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        MurmurHash3_x64_128(word, strlen(word), SALT_CONSTANT, hashes[i]);
+    }
+    fclose(fp);
+    printf("mode   first_fail_load  failures  ns/insert  false_negatives\n");
+    for (m = 0; m < 2; m++) {
+        if (!(cc = new_cache(CAPACITY*2))) {
+            fprintf(stderr, "ERROR: Could not create cache\n");
+            return TEST_FAIL;
+        }
+        first_fail = -1;
+        failures = 0;
+        lost = 0;
+        t0 = test_gettime();
+        for (i = 0; i< CAPACITY; i++) {
+            hh[0] = hashes[i][0];
+            hh[1] = hashes[i][1];
+            failed[i] = (add[m](cc, hh) != NULL);
+            if (failed[i]) {
+                failures++;
+                if (first_fail < 0) {
+                    first_fail = cc->count;
+                }
+            }
+        }
+        t1 = test_gettime();
+        for (i = 0; i< CAPACITY; i++) {
+            if (!cc_contains_item(cc, hashes[i])) {
+                lost++;
+                /* BFS must never drop an item it reported as inserted */
+                lost_bfs += (m == 1 && !failed[i]);
+            }
+        }
+        printf("%-6s %15.4f  %8d  %9.1f  %15d\n",
+               names[m],
+               (double)(first_fail < 0 ? cc->count : first_fail) / cc->size_k,
+               failures,
+               (double)(t1 - t0) / CAPACITY,
+               lost);
+        remove_cache(cc);
+    }
+#if INSERT_MODE == INSERT_BFS
+    /* Through the filter a failed search moves to a new cache, nothing is knocked out */
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY*2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        hh[0] = hashes[i][0];
+        hh[1] = hashes[i][1];
+        trcf_add_hash(trcf, hh);
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        lost_bfs += !trcf_contains_hash(trcf, hashes[i]);
+    }
+    printf("filter caches %u, false_negatives %d\n", min(trcf->idx, trcf->siz), lost_bfs);
+    remove_time_rotated_cache_filter(trcf);
+#endif
+    if (lost_bfs != 0) {
+        printf("TEST FAIL (bfs insert lost %d fingerprints)\n", lost_bfs);
+        return TEST_FAIL;
+    }
+    printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
 int test_trc(const char *words_file) {
     time_rotated_cache_t * trc;
     int i;
@@ -211,6 +304,64 @@ int test_trc(const char *words_file) {
     return print_results(&results);
 }
 
+/* A compacted cache must answer exactly as the sparse one did, in less memory */
+int test_trc_compact(const char *words_file) {
+    time_rotated_cache_t * trc;
+    static int before[CAPACITY*2];
+    int i, mismatches = 0;
+    uint64_t sparse_memory, compact_memory;
+    char word[256];
+    FILE *fp;
+    uint64_t hh[2];
+    struct stats results = { 0 };
+    printf("\n** Testing Time-Rotated-Cache Compaction \n");
+    if (!(trc = new_time_rotated_cache(CAPACITY*2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        MurmurHash3_x64_128(word, strlen(word), SALT_CONSTANT, hh);
+        trc_add_item(trc, hh);
+    }
+    fseek(fp, 0, SEEK_SET);
+    for (i = 0; i< CAPACITY*2; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        MurmurHash3_x64_128(word, strlen(word), SALT_CONSTANT, hh);
+        before[i] = trc_contains_item(trc, hh);
+    }
+    sparse_memory = trc_memory(trc);
+    if (!trc_compact(trc)) {
+        fprintf(stderr, "ERROR: Could not compact cache\n");
+        return TEST_FAIL;
+    }
+    fseek(fp, 0, SEEK_SET);
+    for (i = 0; i< CAPACITY*2; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        MurmurHash3_x64_128(word, strlen(word), SALT_CONSTANT, hh);
+        score(trc_contains_item(trc, hh), i < CAPACITY, &results, word);
+        mismatches += (trc_contains_item(trc, hh) != before[i]);
+    }
+    fclose(fp);
+    compact_memory = trc_memory(trc);
+    remove_time_rotated_cache(trc);
+    printf("Memory sparse:      %7llu \n", (unsigned long long)sparse_memory);
+    printf("Memory compact:     %7llu \n", (unsigned long long)compact_memory);
+    printf("Mismatches:         %7d \n", mismatches);
+    if (mismatches || compact_memory >= sparse_memory) {
+        printf("TEST FAIL (compacted cache differs or is not smaller)\n");
+        return TEST_FAIL;
+    }
+    return print_results(&results);
+}
+
 int test_trcf(const char *words_file) {
     time_rotated_cache_filter_t * trcf;
     int i;
@@ -256,6 +407,446 @@ int test_trcf(const char *words_file) {
     return print_results(&results);
 }
 
+int test_trcf_bulk(const char *words_file) {
+    time_rotated_cache_filter_t * bulk, * seq;
+    time_rotated_cache_t * single;
+    static char words[CAPACITY*2][256];
+    static const char * keys[CAPACITY*2];
+    static size_t lens[CAPACITY*2];
+    int i, in_bulk, mismatches = 0;
+    FILE *fp;
+    uint64_t t0, t1, t2, t3;
+    struct stats results = { 0 };
+    printf("\n** Testing Time-Rotated-Cache-Filter Bulk Load \n");
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY*2; i++) {
+        fgets(words[i], sizeof(words[i]), fp);
+        chomp_line(words[i]);
+        keys[i] = words[i];
+        lens[i] = strlen(words[i]);
+    }
+    fclose(fp);
+    t0 = test_gettime();
+    if (!(bulk = new_time_rotated_cache_filter_bulk(keys, lens, CAPACITY, 0))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    t1 = test_gettime();
+    if (!(single = new_time_rotated_cache_bulk(keys, lens, CAPACITY, 1))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    remove_time_rotated_cache(single);
+    t2 = test_gettime();
+    /* Sequential inserts into a cache of the same size for comparison */
+    if (!(seq = new_time_rotated_cache_filter(trcf_get(bulk, -1)->size_k))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        trcf_add_item(seq, keys[i], lens[i]);
+    }
+    t3 = test_gettime();
+    for (i = 0; i< CAPACITY*2; i++) {
+        in_bulk = trcf_contains_item(bulk, keys[i], lens[i]);
+        score(in_bulk, i < CAPACITY, &results, keys[i]);
+        mismatches += (in_bulk != trcf_contains_item(seq, keys[i], lens[i]));
+    }
+    printf("Bulk load (%2li threads): %.3f ms \n", sysconf(_SC_NPROCESSORS_ONLN), (double)(t1 - t0) / 1000000);
+    printf("Bulk load ( 1 thread):  %.3f ms \n", (double)(t2 - t1) / 1000000);
+    printf("Sequential inserts:    %.3f ms \n", (double)(t3 - t2) / 1000000);
+    printf("Caches bulk/seq:       %i/%i \n", min(bulk->idx, bulk->siz), min(seq->idx, seq->siz));
+    printf("Count bulk/seq:        %llu/%llu \n",
+           (unsigned long long)trcf_get(bulk, -1)->count, (unsigned long long)trcf_get(seq, -1)->count);
+    printf("Mismatches:            %i \n", mismatches);
+    remove_time_rotated_cache_filter(bulk);
+    remove_time_rotated_cache_filter(seq);
+    if (mismatches) {
+        printf("TEST FAIL (bulk load differs from sequential inserts)\n");
+        return TEST_FAIL;
+    }
+    return print_results(&results);
+}
+
+/* A bulk loaded filter must keep rotating at full size: bulk keys survive
+ * later generations, and a bulk load that leaves no room for them is refused */
+int test_trcf_bulk_warm_start(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    static char words[CAPACITY*4][256];
+    static const char * keys[CAPACITY*4];
+    static size_t lens[CAPACITY*4];
+    int i, lost = 0;
+    FILE *fp;
+    printf("\n** Testing Time-Rotated-Cache-Filter Bulk Load Warm Start \n");
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY*4; i++) {
+        fgets(words[i], sizeof(words[i]), fp);
+        chomp_line(words[i]);
+        keys[i] = words[i];
+        lens[i] = strlen(words[i]);
+    }
+    fclose(fp);
+    /* Sized past MAX_MEMORY, the keys are never read */
+    if (new_time_rotated_cache_filter_bulk(keys, lens, MAX_MEMORY, 1) != NULL) {
+        printf("TEST FAIL (bulk load beyond MAX_MEMORY accepted)\n");
+        return TEST_FAIL;
+    }
+    if (!(trcf = new_time_rotated_cache_filter_bulk(keys, lens, CAPACITY, 0))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    for (i = CAPACITY; i< CAPACITY*4; i++) {
+        trcf_add_item(trcf, keys[i], lens[i]);
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        lost += !trcf_contains_item(trcf, keys[i], lens[i]);
+    }
+    printf("Caches:                %i \n", min(trcf->idx, trcf->siz));
+    printf("Bulk size_k/newest:    %llu/%llu \n",
+           (unsigned long long)trcf_get(trcf, 0)->size_k, (unsigned long long)trcf_get(trcf, -1)->size_k);
+    printf("Bulk keys lost:        %i \n", lost);
+    if (trcf->idx < 3 || lost) {
+        printf("TEST FAIL (bulk keys lost after %i rotations)\n", trcf->idx - 1);
+        remove_time_rotated_cache_filter(trcf);
+        return TEST_FAIL;
+    }
+    remove_time_rotated_cache_filter(trcf);
+    printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
+/* Fixed-width keys: singles and batches must agree, no false positives */
+int test_trcf_fixed_width(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    static uint64_t keys[CAPACITY*2];
+    static uint64_t keys128[CAPACITY*2][2];
+    static int out[CAPACITY*2];
+    int i, mismatches = 0;
+    struct stats results = { 0 };
+    printf("\n** Testing Time-Rotated-Cache-Filter Fixed-Width Keys \n");
+    for (i = 0; i< CAPACITY*2; i++) {
+        keys[i] = (uint64_t)i * 0x100000001b3llu;
+        keys128[i][0] = keys[i];
+        keys128[i][1] = ~keys[i];
+    }
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY*2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    trcf_add_if_new_batch_u64(trcf, keys, CAPACITY, out);
+    for (i = 0; i< CAPACITY; i++) {
+        mismatches += !out[i];
+    }
+    for (i = 0; i< CAPACITY/2; i++) {
+        trcf_add_item_u128(trcf, keys128[i]);
+    }
+    trcf_add_if_new_batch_u128(trcf, keys128 + CAPACITY/2, CAPACITY/2, out);
+    for (i = 0; i< CAPACITY/2; i++) {
+        mismatches += !out[i];
+    }
+    trcf_contains_batch_u64(trcf, keys, CAPACITY*2, out);
+    for (i = 0; i< CAPACITY*2; i++) {
+        score(out[i], i < CAPACITY, &results, "u64 key");
+        mismatches += (out[i] != trcf_contains_item_u64(trcf, keys[i]));
+    }
+    trcf_contains_batch_u128(trcf, keys128, CAPACITY*2, out);
+    for (i = 0; i< CAPACITY*2; i++) {
+        score(out[i], i < CAPACITY, &results, "u128 key");
+        mismatches += (out[i] != trcf_contains_item_u128(trcf, keys128[i]));
+    }
+    /* SALT_CONSTANT mixes to fingerprint 0, the empty slot marker */
+    mismatches += trcf_contains_item_u64(trcf, SALT_CONSTANT);
+    mismatches += !trcf_add_if_new_u64(trcf, SALT_CONSTANT);
+    mismatches += !trcf_contains_item_u64(trcf, SALT_CONSTANT);
+    print_trcf_stat(trcf);
+    remove_time_rotated_cache_filter(trcf);
+    printf("Mismatches:         %7d \n", mismatches);
+    if (mismatches) {
+        printf("TEST FAIL (batch and single results differ, or key SALT_CONSTANT mishandled)\n");
+        return TEST_FAIL;
+    }
+    return print_results(&results);
+}
+
+/* Non-empty slots of a cache, sparse or compacted */
+static uint64_t trc_live(time_rotated_cache_t * trc) {
+    uint64_t i, n = 0;
+    uint64_t slots = (trc->dir != NULL ? trc->dir[(uint64_t)1 << trc->dir_bits] : trc->size_k);
+    for (i = 0; i < slots; i++) {
+        n += (trc->state[i] != 0);
+    }
+    return n;
+}
+
+/* Remove half the words with trcf_remove_batch and a quarter one at a time */
+int test_trcf_remove(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    static char words[CAPACITY][256];
+    static const char * keys[CAPACITY];
+    static size_t lens[CAPACITY];
+    static int before[CAPACITY], out[CAPACITY];
+    static uint64_t counts[MAX_CACHES];
+    int i, still_present = 0, lost = 0, drift = 0;
+    uint64_t zero_fp[2] = { 12345, 0 };
+    FILE *fp;
+    printf("\n** Testing Time-Rotated-Cache-Filter Removal \n");
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY/2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        fgets(words[i], sizeof(words[i]), fp);
+        chomp_line(words[i]);
+        keys[i] = words[i];
+        lens[i] = strlen(words[i]);
+        trcf_add_item(trcf, keys[i], lens[i]);
+    }
+    fclose(fp);
+    for (i = 0; i< CAPACITY; i++) {
+        before[i] = trcf_contains_item(trcf, keys[i], lens[i]);
+    }
+    trcf_remove_batch(trcf, keys, lens, CAPACITY/2, out);
+    for (i = CAPACITY/2; i< CAPACITY*3/4; i++) {
+        out[i] = trcf_remove_item(trcf, keys[i], lens[i]);
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        if (i < CAPACITY*3/4) {
+            still_present += trcf_contains_item(trcf, keys[i], lens[i]);
+            lost += (out[i] != before[i]);
+        } else {
+            lost += (trcf_contains_item(trcf, keys[i], lens[i]) != before[i]);
+        }
+    }
+    /* Keys that are not present, including fingerprint 0 against empty slots and
+     * the zeroed slots removals leave in compacted runs, must not change count */
+    for (i = 1; i < min(trcf->idx, trcf->siz) + 1; i++) {
+        counts[i-1] = trcf_get(trcf, -i)->count;
+    }
+    lost += trcf_remove_item(trcf, keys[0], lens[0]);
+    lost += trcf_remove_item_u64(trcf, SALT_CONSTANT);
+    lost += trcf_remove_hash(trcf, zero_fp);
+    for (i = 1; i < min(trcf->idx, trcf->siz) + 1; i++) {
+        drift += (trcf_get(trcf, -i)->count != counts[i-1]);
+        drift += (trcf_get(trcf, -i)->count != trc_live(trcf_get(trcf, -i)));
+    }
+    print_trcf_stat(trcf);
+    remove_time_rotated_cache_filter(trcf);
+    printf("Still present:      %7d \n", still_present);
+    printf("Wrong results:      %7d \n", lost);
+    printf("Caches with count drift: %2d \n", drift);
+    if (still_present || lost || drift) {
+        printf("TEST FAIL (removal incorrect)\n");
+        return TEST_FAIL;
+    }
+    printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
+static int engine_results[CAPACITY*2];
+
+static void engine_done(void * tag, int found) {
+    engine_results[(int *)tag - engine_results] = found + 1;
+}
+
+/* Lookup engine results must match trcf_contains_item across rotated and compacted caches */
+int test_lookup_engine(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    lookup_engine_t * le;
+    static char words[CAPACITY*2][256];
+    int i, mismatches = 0, missing = 0;
+    FILE *fp;
+    struct stats results = { 0 };
+    printf("\n** Testing Lookup Engine \n");
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY/2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    if (!(le = new_lookup_engine(trcf, engine_done))) {
+        fprintf(stderr, "ERROR: Could not create lookup engine\n");
+        return TEST_FAIL;
+    }
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY*2; i++) {
+        fgets(words[i], sizeof(words[i]), fp);
+        chomp_line(words[i]);
+        if (i < CAPACITY) {
+            trcf_add_item(trcf, words[i], strlen(words[i]));
+        }
+    }
+    fclose(fp);
+    for (i = 0; i< CAPACITY*2; i++) {
+        le_submit(le, words[i], strlen(words[i]), &engine_results[i]);
+    }
+    le_drain(le);
+    for (i = 0; i< CAPACITY*2; i++) {
+        missing += (engine_results[i] == 0);
+        score(engine_results[i] == 2, i < CAPACITY, &results, words[i]);
+        mismatches += ((engine_results[i] == 2) != trcf_contains_item(trcf, words[i], strlen(words[i])));
+    }
+    print_trcf_stat(trcf);
+    remove_lookup_engine(le);
+    remove_time_rotated_cache_filter(trcf);
+    printf("Not completed:      %7d \n", missing);
+    printf("Mismatches:         %7d \n", mismatches);
+    if (missing || mismatches) {
+        printf("TEST FAIL (lookup engine differs from trcf_contains_item)\n");
+        return TEST_FAIL;
+    }
+    return print_results(&results);
+}
+
+/* Adds between submits rotate caches under in-flight lookups, which restart from the
+ * newest cache without recording a check twice */
+int test_lookup_engine_rotation(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    lookup_engine_t * le;
+    time_rotated_cache_t * old;
+    static char words[CAPACITY*2][256];
+    int i, mismatches = 0, missing = 0, double_counted;
+    uint32_t idx;
+    FILE *fp;
+    struct stats results = { 0 };
+    printf("\n** Testing Lookup Engine Under Rotation \n");
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY*2; i++) {
+        fgets(words[i], sizeof(words[i]), fp);
+        chomp_line(words[i]);
+        engine_results[i] = 0;
+    }
+    fclose(fp);
+    /* A single in-flight lookup across one rotation probes each cache once */
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY/8))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    if (!(le = new_lookup_engine(trcf, engine_done))) {
+        fprintf(stderr, "ERROR: Could not create lookup engine\n");
+        return TEST_FAIL;
+    }
+    old = trcf_get(trcf, -1);
+    le_submit(le, words[0], strlen(words[0]), &engine_results[0]);
+    trcf_add_cache_best_guess(trcf);
+    le_drain(le);
+    double_counted = (old->checks->idx != 1 || trcf_get(trcf, -1)->checks->idx != 1);
+    engine_results[0] = 0;
+    /* Every added word is submitted straight after its add, and a word never added
+     * after that, while the adds keep rotating caches */
+    idx = trcf->idx;
+    for (i = 0; i< CAPACITY; i++) {
+        trcf_add_item(trcf, words[i], strlen(words[i]));
+        le_submit(le, words[i], strlen(words[i]), &engine_results[i]);
+        le_submit(le, words[CAPACITY + i], strlen(words[CAPACITY + i]), &engine_results[CAPACITY + i]);
+    }
+    le_drain(le);
+    for (i = 0; i< CAPACITY; i++) {
+        missing += (engine_results[i] == 0) + (engine_results[CAPACITY + i] == 0);
+        score(engine_results[i] == 2, 1, &results, words[i]);
+        score(engine_results[CAPACITY + i] == 2, 0, &results, words[CAPACITY + i]);
+        mismatches += (engine_results[i] != 2) + (engine_results[CAPACITY + i] != 1);
+    }
+    idx = trcf->idx - idx;
+    printf("Rotations:          %7u \n", idx);
+    print_trcf_stat(trcf);
+    remove_lookup_engine(le);
+    remove_time_rotated_cache_filter(trcf);
+    printf("Not completed:      %7d \n", missing);
+    printf("Mismatches:         %7d \n", mismatches);
+    printf("Checks recorded twice: %4s \n", double_counted ? "yes" : "no");
+    if (missing || mismatches || double_counted || idx == 0) {
+        printf("TEST FAIL (lookup engine wrong across rotations, or none happened)\n");
+        return TEST_FAIL;
+    }
+    return print_results(&results);
+}
+
+int test_trace(const char *words_file) {
+    time_rotated_cache_filter_t * trcf;
+    trace_t * tr;
+    trace_record_t rec;
+    int i, mismatches = 0;
+    size_t records = 0;
+    uint64_t last = 0;
+    char word[256];
+    FILE *fp;
+    uint64_t hh[2];
+    printf("\n** Testing Trace Record \n");
+    if (!(trcf = new_time_rotated_cache_filter(CAPACITY/2))) {
+        fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    if (!trcf_trace_start(trcf, TRACE_TEST_FILE)) {
+        fprintf(stderr, "ERROR: Could not create trace file\n");
+        return TEST_FAIL;
+    }
+    if (!(fp = fopen(words_file, "r"))) {
+        fprintf(stderr, "ERROR: Could not open words file\n");
+        return TEST_FAIL;
+    }
+    for (i = 0; i< CAPACITY; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        trcf_add_item(trcf, word, strlen(word));
+        trcf_contains_item(trcf, word, strlen(word));
+    }
+    mismatches += !trcf_trace_stop(trcf);
+    /* A full device must be reported by trcf_trace_stop, not leave a silently short trace */
+    if (trcf_trace_start(trcf, "/dev/full")) {
+        trcf_add_item(trcf, word, strlen(word));
+        mismatches += trcf_trace_stop(trcf);
+    }
+    remove_time_rotated_cache_filter(trcf);
+
+    if (!(tr = open_trace(TRACE_TEST_FILE))) {
+        fprintf(stderr, "ERROR: Could not open trace file\n");
+        return TEST_FAIL;
+    }
+    mismatches += (tr->size_k != CAPACITY/2);
+    fseek(fp, 0, SEEK_SET);
+    for (i = 0; i< CAPACITY; i++) {
+        fgets(word, sizeof(word), fp);
+        chomp_line(word);
+        MurmurHash3_x64_128(word, strlen(word), SALT_CONSTANT, hh);
+        for (int op = TRACE_ADD; op <= TRACE_CONTAINS; op++) {
+            if (trace_read(tr, &rec, 1) != 1) {
+                break;
+            }
+            records++;
+            if (rec.hh[0] != hh[0] || rec.hh[1] != hh[1] || TRACE_OP(&rec) != op || TRACE_TIME(&rec) < last) {
+                mismatches++;
+            }
+            last = TRACE_TIME(&rec);
+        }
+    }
+    records += trace_read(tr, &rec, 1);
+    fclose(fp);
+    remove_trace(tr);
+    remove(TRACE_TEST_FILE);
+    printf("Records:            %7zu \n", records);
+    printf("Mismatches:         %7d \n", mismatches);
+    if (records != 2*CAPACITY || mismatches) {
+        printf("TEST FAIL (trace does not match operations)\n");
+        return TEST_FAIL;
+    }
+    printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
 int main(int argc, char *argv[]) {
     int i, failures = 0, warnings = 0;
     if (argc != 2) {
@@ -264,8 +855,17 @@ int main(int argc, char *argv[]) {
     }
     int (*tests[])(const char *) = {
         test_cc,
+        test_cc_insert_modes,
         test_trc,
+        test_trc_compact,
         test_trcf,
+        test_trcf_bulk,
+        test_trcf_bulk_warm_start,
+        test_trcf_fixed_width,
+        test_lookup_engine,
+        test_lookup_engine_rotation,
+        test_trcf_remove,
+        test_trace,
         NULL,
     };
     for (i = 0; tests[i] != NULL;  i++) {
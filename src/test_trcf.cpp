@@ -0,0 +1,193 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "trcf.hpp"
+#include "trcfapi.h"
+
+/**
+ * Tests for the C++ template front-end: every shape of filter<> must hold what
+ * was added, exact (u64) fingerprints must not give false positives, and the
+ * default filter<> must answer as the C library does for the same keys.
+ * */
+
+#define CAPACITY 8192*2
+
+enum {
+    TEST_PASS,
+    TEST_WARN,
+    TEST_FAIL,
+};
+
+struct pow2_config : trcf::default_config {
+    static constexpr bool power_of_two = true;
+};
+
+struct walk_config : trcf::default_config {
+    static constexpr bool insert_bfs = false;
+};
+
+/* The first CAPACITY keys are added, the next CAPACITY are not.
+ * Sized at 25% load, so with the walk nothing is knocked out either */
+template <typename Fingerprint, unsigned Ways, typename Config = trcf::default_config>
+static int check_filter(const char * name, const std::vector<std::string_view> & keys, bool exact) {
+    trcf::filter<Fingerprint, Ways, trcf::murmur3_128, Config> f(CAPACITY * 4 / Ways);
+    std::unique_ptr<bool[]> out(new bool[keys.size()]);
+    int false_negatives = 0, false_positives = 0, mismatches = 0;
+    std::printf("\n** Testing %s \n", name);
+    for (std::size_t i = 0; i < CAPACITY; i++) {
+        f.add(keys[i]);
+    }
+    f.contains(std::span<const std::string_view>(keys), std::span<bool>(out.get(), keys.size()));
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        bool found = f.contains(keys[i]);
+        mismatches += (found != out[i]);
+        if (i < CAPACITY) {
+            false_negatives += !found;
+        } else {
+            false_positives += found;
+        }
+    }
+    std::printf("Generations:      %u \n", f.generations());
+    std::printf("Newest size_k:    %llu \n", (unsigned long long)f.get(1).size_k());
+    std::printf("False negatives:  %i \n", false_negatives);
+    std::printf("False positives:  %i \n", false_positives);
+    std::printf("Batch mismatches: %i \n", mismatches);
+    if (false_negatives || mismatches || (exact && false_positives)) {
+        std::printf("TEST FAIL\n");
+        return TEST_FAIL;
+    }
+    std::printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
+static int test_ways_1(const std::vector<std::string_view> & keys) {
+    return check_filter<uint64_t, 1>("filter<uint64_t, 1>", keys, true);
+}
+
+static int test_ways_4(const std::vector<std::string_view> & keys) {
+    return check_filter<uint64_t, 4>("filter<uint64_t, 4>", keys, true);
+}
+
+static int test_walk(const std::vector<std::string_view> & keys) {
+    return check_filter<uint64_t, 4, walk_config>("filter<uint64_t, 4> (walk)", keys, true);
+}
+
+static int test_power_of_two(const std::vector<std::string_view> & keys) {
+    int result = check_filter<uint64_t, 1, pow2_config>("filter<uint64_t, 1> (power_of_two)", keys, true);
+    trcf::filter<uint64_t, 1, trcf::murmur3_128, pow2_config> f(CAPACITY * 3);
+    if (f.get(1).size_k() != CAPACITY * 4) {
+        std::printf("TEST FAIL (size_k %llu not rounded up to %llu)\n",
+                    (unsigned long long)f.get(1).size_k(), (unsigned long long)(CAPACITY * 4));
+        return TEST_FAIL;
+    }
+    return result;
+}
+
+/* Narrow fingerprints can collide, so only false negatives are checked */
+static int test_narrow_fingerprint(const std::vector<std::string_view> & keys) {
+    if (check_filter<uint16_t, 4>("filter<uint16_t, 4>", keys, false) == TEST_FAIL) {
+        return TEST_FAIL;
+    }
+    return check_filter<uint32_t, 1>("filter<uint32_t, 1>", keys, false);
+}
+
+/* Generations too small for the keys: BFS rotates rather than knocking a fingerprint out */
+static int test_rotation(const std::vector<std::string_view> & keys) {
+    trcf::filter<uint64_t, 4> f(CAPACITY / 8);
+    int false_negatives = 0;
+    std::printf("\n** Testing filter<uint64_t, 4> rotation \n");
+    for (std::size_t i = 0; i < CAPACITY; i++) {
+        f.add(keys[i]);
+    }
+    for (std::size_t i = 0; i < CAPACITY; i++) {
+        false_negatives += !f.contains(keys[i]);
+    }
+    std::printf("Rotations:        %u \n", f.rotations());
+    std::printf("False negatives:  %i \n", false_negatives);
+    if (f.rotations() == 0 || f.generations() == trcf::default_config::max_caches || false_negatives) {
+        std::printf("TEST FAIL\n");
+        return TEST_FAIL;
+    }
+    std::printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
+/* The default filter<> and the C library, fed the same keys, must agree on all of them */
+static int test_matches_c(const std::vector<std::string_view> & keys) {
+    trcf::filter<> f(CAPACITY * 4);
+    time_rotated_cache_filter_t * c;
+    int mismatches = 0;
+    std::printf("\n** Testing filter<> against the C library \n");
+    if (!(c = new_time_rotated_cache_filter(CAPACITY * 4))) {
+        std::fprintf(stderr, "ERROR: Could not create cache\n");
+        return TEST_FAIL;
+    }
+    for (std::size_t i = 0; i < CAPACITY; i++) {
+        f.add(keys[i]);
+        trcf_add_item(c, keys[i].data(), keys[i].size());
+    }
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        mismatches += (f.contains(keys[i]) != (bool)trcf_contains_item(c, keys[i].data(), keys[i].size()));
+    }
+    for (std::size_t i = CAPACITY; i < keys.size(); i++) {
+        mismatches += (f.add_if_new(keys[i]) != (bool)trcf_add_if_new(c, keys[i].data(), keys[i].size()));
+    }
+    std::printf("Mismatches:       %i \n", mismatches);
+    remove_time_rotated_cache_filter(c);
+    if (mismatches) {
+        std::printf("TEST FAIL\n");
+        return TEST_FAIL;
+    }
+    std::printf("TEST PASS\n");
+    return TEST_PASS;
+}
+
+int main(int argc, char *argv[]) {
+    int i, failures = 0, warnings = 0;
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s <words_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::fprintf(stderr, "ERROR: Could not open words file\n");
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> words;
+    for (std::string line; words.size() < CAPACITY * 2 && std::getline(in, line); ) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        words.push_back(line);
+    }
+    if (words.size() < CAPACITY * 2) {
+        std::fprintf(stderr, "ERROR: Words file has fewer than %i words\n", CAPACITY * 2);
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string_view> keys(words.begin(), words.end());
+    int (*tests[])(const std::vector<std::string_view> &) = {
+        test_ways_1,
+        test_ways_4,
+        test_walk,
+        test_power_of_two,
+        test_narrow_fingerprint,
+        test_rotation,
+        test_matches_c,
+        NULL,
+    };
+    for (i = 0; tests[i] != NULL; i++) {
+        int result = (tests[i])(keys);
+        if (result == TEST_FAIL) {
+            failures++;
+        } else if (result == TEST_WARN) {
+            warnings++;
+        }
+    }
+    std::printf("\n** %d failures, %d warnings\n", failures, warnings);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
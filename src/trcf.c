@@ -1,4 +1,6 @@
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "trcf.h"
 #include "murmur.h"
 
@@ -6,42 +8,108 @@
  * Circular Array Access
  * */
  
+/* Position of element i (0 oldest, -1 newest) in a ring of siz after idx appends */
+static inline int ring_pos(uint32_t idx, uint32_t siz, int i) {
+    int n = min(idx, siz);
+    if (n == 0) {
+        return 0;
+    }
+    return ((idx > siz ? idx % siz : 0) + (i % n + n) % n) % siz;
+}
+
 static inline void ct_append(check_times_t * ct, uint64_t tv) {
     ct->array[MOD((ct->idx++), ct->siz)] = tv;
 }
-inline uint64_t ct_get(check_times_t * ct, int i) {
-    return (ct->array[(ct->idx > ct->siz ? MOD((i + ct->idx), ct->siz) : MOD(i, ct->idx ))]); 
-}
 static inline int ct_pos(check_times_t * ct, int i) {
-    return (ct->idx > ct->siz ? MOD((i + ct->idx), ct->siz) : MOD(i, ct->idx));
+    return ring_pos(ct->idx, ct->siz, i);
+}
+inline uint64_t ct_get(check_times_t * ct, int i) {
+    return (ct->array[ct_pos(ct, i)]); 
 }
 
 static inline void trcf_append(time_rotated_cache_filter_t * trcf, time_rotated_cache_t * trc) {
     trcf->caches[MOD((trcf->idx++), trcf->siz)] = trc;
 }
-inline time_rotated_cache_t * trcf_get(time_rotated_cache_filter_t * trcf, int i) {
-    return (trcf->caches[ (trcf->idx > trcf->siz ? MOD((i + trcf->idx), trcf->siz) : MOD(i,trcf->idx )) ]); 
-}
 static inline int trcf_pos(time_rotated_cache_filter_t * trcf, int i) {
-    return (trcf->idx > trcf->siz ? MOD((i + trcf->idx), trcf->siz) : MOD(i, trcf->idx));
+    return ring_pos(trcf->idx, trcf->siz, i);
+}
+inline time_rotated_cache_t * trcf_get(time_rotated_cache_filter_t * trcf, int i) {
+    return (trcf->caches[trcf_pos(trcf, i)]); 
 }
 
-/* Time as uint64 */
-uint64_t ct_gettime(void) {
+/* Monotonic time as uint64 */
+static uint64_t ct_monotonic(void) {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return (ts.tv_sec*1000000000llu+ts.tv_nsec);
 }
 
+static uint64_t (*ct_clock)(void) = ct_monotonic;
+
+/* Time as uint64 */
+uint64_t ct_gettime(void) {
+    return ct_clock();
+}
+
+/* Replace the time source, e.g. with a virtual clock for trace replay. NULL restores the monotonic clock */
+void trcf_set_clock(uint64_t (*clock)(void)) {
+    ct_clock = (clock != NULL ? clock : ct_monotonic);
+}
+
+/* 0 marks an empty slot, so no key may hash to fingerprint 0 */
+static inline void HASH_FIX_FP(uint64_t hh[2]) {
+    hh[1] += (hh[1] == 0);
+}
+
 /* Hash 128 bits */
 static void HASH_128(const char *s, size_t len, uint64_t hh[2]) { 
     MurmurHash3_x64_128(s, len, SALT_CONSTANT, hh);
+    HASH_FIX_FP(hh);
+}
+
+/* MurmurHash3 finalization mix */
+static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdllu;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53llu;
+    k ^= k >> 33;
+    return k;
+}
+
+/* Hash a 64 bit key to 128 bits. fmix64 is a bijection, so distinct keys never share
+ * a fingerprint, except SALT_CONSTANT whose fingerprint 0 is remapped to 1 */
+static inline void HASH_U64(uint64_t key, uint64_t hh[2]) {
+    hh[1] = fmix64(key ^ SALT_CONSTANT);
+    hh[0] = fmix64(hh[1] + 0x9e3779b97f4a7c15llu);
+    HASH_FIX_FP(hh);
+}
+
+/* Hash a 128 bit key to 128 bits, every key bit reaches both halves */
+static inline void HASH_U128(const uint64_t key[2], uint64_t hh[2]) {
+    hh[0] = fmix64(key[0] ^ SALT_CONSTANT);
+    hh[1] = fmix64(key[1] ^ 0x9e3779b97f4a7c15llu) + hh[0];
+    hh[1] = fmix64(hh[1]);
+    hh[0] = fmix64(hh[0] + hh[1]);
+    HASH_FIX_FP(hh);
 }
 
 /** 
  * Cuckoo-Cache Methods
  * */
 
+/* Alternate index of fp stored at ind, alt(alt(ind)) == ind for any size_k */
+static inline uint64_t cc_alt_index(cache_t * cc, uint64_t ind, uint64_t fp) {
+    return (fp % cc->size_k + cc->size_k - ind) % cc->size_k;
+}
+
+/* Prefetch both candidate slots of hh */
+static inline void cc_prefetch(cache_t * cc, uint64_t hh[2]) {
+    uint64_t ind = hh[0] % cc->size_k;
+    __builtin_prefetch(&cc->state[ind]);
+    __builtin_prefetch(&cc->state[cc_alt_index(cc, ind, hh[1])]);
+}
+
 static cache_t * init_cache(cache_t * cc, uint64_t size_k) {
     if ((cc->state = (uint64_t *)calloc(size_k, sizeof(uint64_t))) == NULL) {
         return NULL;
@@ -81,28 +149,77 @@ uint64_t * cc_add_item(cache_t * cc, uint64_t hh[]) {
             cc->count++;
             return NULL;
         }
-        ind = (ind^fp) % cc->size_k;
+        ind = cc_alt_index(cc, ind, fp);
     }
     hh[0] = ind;
     hh[1] = fp;
     return hh;
 }
+/* Bounded breadth-first search for the shortest eviction path from either
+ * candidate index. Items are only moved once a path to an empty slot is found,
+ * so nothing is dropped: on failure hh is returned unmodified. */
+uint64_t * cc_add_item_bfs(cache_t * cc, uint64_t hh[]) {
+    uint64_t path[2][BFS_MAX_DEPTH];
+    uint64_t fp, next;
+    int alive[2] = { 1, 1 };
+    int c, d, j;
+    fp = hh[1];
+    path[0][0] = hh[0] % cc->size_k;
+    path[1][0] = cc_alt_index(cc, path[0][0], fp);
+    if (cc->state[path[0][0]] == fp || cc->state[path[1][0]] == fp) {
+        return NULL;
+    }
+    /* With one slot per index each candidate starts a single chain of evictions,
+     * search both a level at a time */
+    for (d=0; d < BFS_MAX_DEPTH; d++) {
+        for (c=0; c < 2; c++) {
+            if (!alive[c]) {
+                continue;
+            }
+            if (cc->state[path[c][d]] == 0) {
+                for (j=d; j > 0; j--) {
+                    cc->state[path[c][j]] = cc->state[path[c][j-1]];
+                }
+                cc->state[path[c][0]] = fp;
+                cc->count++;
+                return NULL;
+            }
+            if (d + 1 == BFS_MAX_DEPTH) {
+                alive[c] = 0;
+                continue;
+            }
+            next = cc_alt_index(cc, path[c][d], cc->state[path[c][d]]);
+            for (j=0; j <= d; j++) {
+                if (path[c][j] == next) {
+                    alive[c] = 0;
+                    break;
+                }
+            }
+            path[c][d+1] = next;
+        }
+    }
+    return hh;
+}
+
+/* Clear fp from both candidate slots, returns the number of copies removed.
+ * Fingerprint 0 is never stored, it would match empty slots */
 int cc_remove_item(cache_t * cc, uint64_t hh[]) {
     uint64_t ind, fp;
-    int i;
+    int i, removed = 0;
     ind = hh[0] % cc->size_k;
     fp = hh[1];
-    for (i=0; i < MAX_TRIES; i++) { 
-        if (cc->state[ind] == 0) {
-            return 0; 
-        }
-        else if (cc->state[ind] == fp) {
+    if (fp == 0) {
+        return 0;
+    }
+    for (i=0; i < 2; i++) { 
+        if (cc->state[ind] == fp) {
             cc->state[ind] = 0;
-            return 1;
+            cc->count--;
+            removed++;
         }
-        ind = (ind^fp) % cc->size_k;
+        ind = cc_alt_index(cc, ind, fp);
     }
-    return 0;
+    return removed;
 }
 
 int cc_contains_item(cache_t * cc, uint64_t hh[]) {
@@ -114,7 +231,7 @@ int cc_contains_item(cache_t * cc, uint64_t hh[]) {
         if (cc->state[ind] == fp) {
             return 1;
         }
-        ind = (ind^fp) % cc->size_k;
+        ind = cc_alt_index(cc, ind, fp);
     }
     return 0;
 }
@@ -132,6 +249,8 @@ static time_rotated_cache_t * init_time_rotated_cache(time_rotated_cache_t * trc
     checks->siz = CHECK_TIMES_SIZ;
     checks->idx = 0;
     trc->checks = checks; 
+    trc->dir = NULL;
+    trc->dir_bits = 0;
     return (time_rotated_cache_t*)init_cache((cache_t*)trc, size_k);
 }
 
@@ -146,22 +265,149 @@ time_rotated_cache_t * new_time_rotated_cache(uint64_t size_k) {
 void remove_time_rotated_cache(time_rotated_cache_t * trc) {
     free(trc->state);
     free(trc->checks);
+    free(trc->dir);
     free(trc);
 }
 
+/* Directory group of fp in a compacted cache */
+static inline uint64_t trc_group(time_rotated_cache_t * trc, uint64_t fp) {
+    return (trc->dir_bits ? fp >> (64 - trc->dir_bits) : 0);
+}
+
+/* Position of fp in its run of a compacted cache, or -1. Removals leave zeros in
+ * runs, so fingerprint 0 never matches */
+static int64_t trc_compact_find(time_rotated_cache_t * trc, uint64_t fp) {
+    uint64_t g = trc_group(trc, fp);
+    uint32_t i;
+    if (fp == 0) {
+        return -1;
+    }
+    for (i = trc->dir[g]; i < trc->dir[g+1]; i++) {
+        if (trc->state[i] == fp) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 int trc_contains_item(time_rotated_cache_t * trc, uint64_t hh[2]) {
     ct_append(trc->checks, ct_gettime());
+    if (trc->dir != NULL) {
+        return trc_compact_find(trc, hh[1]) >= 0;
+    }
     return cc_contains_item((cache_t *)trc, hh);
 }
+/* Compacted caches are removed from by zeroing the fingerprint in its run */
 int trc_remove_item(time_rotated_cache_t * trc, uint64_t hh[2]) {
+    int64_t i;
+    if (trc->dir != NULL) {
+        if ((i = trc_compact_find(trc, hh[1])) < 0) {
+            return 0;
+        }
+        trc->state[i] = 0;
+        trc->count--;
+        return 1;
+    }
     return cc_remove_item((cache_t *)trc, hh);
 }
+
+/* Prefetch the first access a lookup or removal of hh makes in trc */
+static inline void trc_prefetch(time_rotated_cache_t * trc, uint64_t hh[2]) {
+    if (trc->dir != NULL) {
+        __builtin_prefetch(&trc->dir[trc_group(trc, hh[1])]);
+    } else {
+        cc_prefetch((cache_t *)trc, hh);
+    }
+}
 uint64_t * trc_add_item(time_rotated_cache_t * trc, uint64_t hh[2]) {
+#if INSERT_MODE == INSERT_BFS
+    return cc_add_item_bfs((cache_t *)trc, hh);
+#else
     return cc_add_item((cache_t *)trc, hh);
+#endif
+}
+
+/* Directory bits for n fingerprints, about COMPACT_GROUP per group */
+static inline uint32_t compact_dir_bits(uint64_t n) {
+    uint32_t bits = 0;
+    while (((uint64_t)COMPACT_GROUP << (bits + 1)) <= n) {
+        bits++;
+    }
+    return bits;
+}
+
+/* Bytes trc_compact allocates for a sparse cache, held alongside the sparse table
+ * until trc_compact frees it */
+static uint64_t trc_compact_memory(time_rotated_cache_t * trc) {
+    if (trc->dir != NULL) {
+        return 0;
+    }
+    return max(trc->count, 1)*sizeof(uint64_t) + (((uint64_t)1 << compact_dir_bits(trc->count)) + 1)*sizeof(uint32_t);
+}
+
+/* Replace the sparse cuckoo table with its fingerprints grouped by their top
+ * dir_bits bits (a counting sort), about COMPACT_GROUP per group. A lookup reads
+ * dir[g], dir[g+1] and one short run of state. The cache must not be added to
+ * afterwards. Returns 0 (cache unchanged) if memory can't be allocated. */
+int trc_compact(time_rotated_cache_t * trc) {
+    uint64_t * fps;
+    uint32_t * dir;
+    uint64_t i, n = 0, groups, g;
+    uint32_t bits;
+    if (trc->dir != NULL) {
+        return 1;
+    }
+    for (i = 0; i < trc->size_k; i++) {
+        n += (trc->state[i] != 0);
+    }
+    if (n >= UINT32_MAX) {
+        return 0;
+    }
+    bits = compact_dir_bits(n);
+    groups = (uint64_t)1 << bits;
+    if ((dir = (uint32_t *)calloc(groups + 1, sizeof(uint32_t))) == NULL) {
+        return 0;
+    }
+    if ((fps = (uint64_t *)malloc(max(n, 1) * sizeof(uint64_t))) == NULL) {
+        free(dir);
+        return 0;
+    }
+    trc->dir_bits = bits;
+    for (i = 0; i < trc->size_k; i++) {
+        if (trc->state[i] != 0) {
+            dir[trc_group(trc, trc->state[i])]++;
+        }
+    }
+    /* dir[g] = end of group g, then filled back down to its start */
+    for (g = 1; g < groups; g++) {
+        dir[g] += dir[g-1];
+    }
+    dir[groups] = n;
+    for (i = 0; i < trc->size_k; i++) {
+        if (trc->state[i] != 0) {
+            fps[--dir[trc_group(trc, trc->state[i])]] = trc->state[i];
+        }
+    }
+    free(trc->state);
+    trc->state = fps;
+    trc->dir = dir;
+    trc->count = n;
+    return 1;
+}
+
+/* Bytes held by the cache's fingerprint storage */
+uint64_t trc_memory(time_rotated_cache_t * trc) {
+    if (trc->dir != NULL) {
+        return trc->dir[(uint64_t)1 << trc->dir_bits]*sizeof(uint64_t) + (((uint64_t)1 << trc->dir_bits) + 1)*sizeof(uint32_t);
+    }
+    return trc->size_k*sizeof(uint64_t);
 }
 
 double trc_checks_per_count_second(time_rotated_cache_t * trc) {
     check_times_t * ct = trc->checks;
+    if (ct->idx < 2) {
+        return NAN;
+    }
     return (double)min(ct->idx, ct->siz) / ((trc->count)*(ct_get(ct, -1) - ct_get(ct, 0) )/1000000000);
 }
 
@@ -169,14 +415,15 @@ double trc_checks_per_count_second(time_rotated_cache_t * trc) {
  * Time-Rotated-Cache-Filter Methods
  * */
  
-static time_rotated_cache_filter_t * init_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf, uint64_t size_k) {
-    time_rotated_cache_t * trc;
-    if ((trc = new_time_rotated_cache(size_k)) == NULL) {
+static time_rotated_cache_filter_t * init_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf, time_rotated_cache_t * trc) {
+    if (trc == NULL) {
+        free(trcf);
         return NULL;
     }
     trcf->caches[0] = trc;
     trcf->idx = 1;
     trcf->siz = MAX_CACHES;
+    trcf->trace = NULL;
     return trcf;
 }
 
@@ -185,7 +432,7 @@ time_rotated_cache_filter_t * new_time_rotated_cache_filter(uint64_t size_k) {
     if ((trcf = (time_rotated_cache_filter_t *)malloc(sizeof(time_rotated_cache_filter_t))) == NULL) {
         return NULL;
     }
-    return init_time_rotated_cache_filter(trcf, size_k);
+    return init_time_rotated_cache_filter(trcf, new_time_rotated_cache(size_k));
 }
 
 void remove_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf) {
@@ -193,6 +440,9 @@ void remove_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf) {
     for (i=1; i< min(trcf->idx, trcf->siz) +1; i++) {
         remove_time_rotated_cache(trcf_get(trcf, -i));
     }
+    if (trcf->trace != NULL) {
+        remove_trace(trcf->trace);
+    }
     free(trcf);
 }
 
@@ -235,10 +485,29 @@ uint64_t trcf_best_guess_size(time_rotated_cache_filter_t * trcf) {
     return (uint64_t)(load_increase > 1.0 ? min(load_increase,MAX_RESCALE)*trc1->size_k : max(load_increase, MAX_RESCALE)*trc1->size_k); 
 }
     
-void trcf_add_cache(time_rotated_cache_filter_t * trcf, uint64_t size_k) {
-    if (trcf->idx > trcf->siz) {
+/* Make room for a new newest cache: free the oldest if the filter is full, then
+ * compact the current newest, which briefly holds both of its encodings. The
+ * ring slot of the oldest must be filled by trcf_append straight after */
+static void trcf_retire_caches(time_rotated_cache_filter_t * trcf) {
+    if (trcf->idx >= trcf->siz) {
         remove_time_rotated_cache(trcf_get(trcf, 0));
     }
+#if COMPACT_COLD
+    /* Only the newest cache is added to, the current one becomes read-only */
+    trc_compact(trcf_get(trcf, -1));
+#endif
+}
+
+/* Append trc as the newest cache, removing the oldest if the filter is full */
+static void trcf_push_cache(time_rotated_cache_filter_t * trcf, time_rotated_cache_t * trc) {
+    trcf_retire_caches(trcf);
+    trcf_append(trcf, trc); 
+}
+
+/* The new cache is allocated last, once the oldest is freed and the sparse table
+ * of the previous newest replaced */
+void trcf_add_cache(time_rotated_cache_filter_t * trcf, uint64_t size_k) {
+    trcf_retire_caches(trcf);
     trcf_append(trcf, new_time_rotated_cache(size_k)); 
 }
 
@@ -251,34 +520,101 @@ uint64_t trcf_total_size_k(time_rotated_cache_filter_t * trcf) {
     return total_size;
 }
 
+uint64_t trcf_total_memory(time_rotated_cache_filter_t * trcf) {
+    uint64_t total_memory = 0;
+    int i;
+    for (i=1; i < min(trcf->idx, trcf->siz) + 1; i++) {
+        total_memory += trc_memory(trcf_get(trcf, -i));
+    }
+    return total_memory;
+}
+
+#if COMPACT_COLD
+/* Bytes reserved per slot of a new cache: its table, plus the dense encoding (at
+ * MAX_OCCUPANCY) that trc_compact allocates beside the table when it is retired */
+#define RESERVED_SLOT_BYTES (sizeof(SIZE_N)*(1 + MAX_OCCUPANCY) + sizeof(uint32_t)*MAX_OCCUPANCY/COMPACT_GROUP)
+#else
+#define RESERVED_SLOT_BYTES sizeof(SIZE_N)
+#endif
+
+/* Bytes of MAX_MEMORY left for a new cache once the next rotation has run */
+static uint64_t trcf_free_memory(time_rotated_cache_filter_t * trcf) {
+    /* The oldest cache is removed to make room if the filter is full, and the newest
+     * compacted before the new cache is allocated */
+    uint64_t current_memory = trcf_total_memory(trcf) - (trcf->idx >= trcf->siz ? trc_memory(trcf_get(trcf, 0)) : 0)
+#if COMPACT_COLD
+                              - trc_memory(trcf_get(trcf, -1)) + trc_compact_memory(trcf_get(trcf, -1))
+#endif
+                              ;
+    return MAX_MEMORY - min(current_memory, MAX_MEMORY);
+}
+
 /* Add a cache scaled to best-guess-size, don't rescale below MIN_SIZE_K */ 
 void trcf_add_cache_best_guess(time_rotated_cache_filter_t * trcf) { 
     uint64_t new_size_k;
-    uint64_t current_memory = trcf_total_size_k(trcf);
-    if ((new_size_k = trcf_best_guess_size(trcf)) > (MAX_MEMORY - SIZE_N*current_memory)) {
-        new_size_k = (MAX_MEMORY - SIZE_N*current_memory)/SIZE_N;
+    uint64_t free_memory = trcf_free_memory(trcf);
+    if ((new_size_k = trcf_best_guess_size(trcf)) > free_memory/RESERVED_SLOT_BYTES) {
+        new_size_k = free_memory/RESERVED_SLOT_BYTES;
     }
     //printf("Adding Cache... new_size_k: %i \n", max(new_size_k, MIN_SIZE_K));
     trcf_add_cache(trcf, max(new_size_k, MIN_SIZE_K));
 }
 
-void trcf_add_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len) {
-    uint64_t hh[2];
-    time_rotated_cache_t * trc1;
-    HASH_128(s, len, hh);
-    trc1= trcf_get(trcf, -1);
-    if (trc_add_item(trc1, hh) != NULL) {
-        /* If a value was popped and the cache is at 50% occupancy add a cache */
-        if (((double)trc1->count / trc1->size_k) > MAX_OCCUPANCY) {
-            trcf_add_cache_best_guess(trcf);
-        }
+/* Record (hash, op, time) of every filter operation to path until trcf_trace_stop */
+int trcf_trace_start(time_rotated_cache_filter_t * trcf, const char * path) {
+    trace_t * tr;
+    if ((tr = new_trace(path, ct_gettime(), trcf_get(trcf, -1)->size_k)) == NULL) {
+        return 0;
+    }
+    if (trcf->trace != NULL) {
+        remove_trace(trcf->trace);
     }
+    trcf->trace = tr;
+    return 1;
 }
 
-int trcf_contains_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len)  {
-    uint64_t hh[2];
+/* Returns 0 if the trace is incomplete because a write failed, e.g. on a full disk */
+int trcf_trace_stop(time_rotated_cache_filter_t * trcf) {
+    int ok = 1;
+    if (trcf->trace != NULL) {
+        ok = remove_trace(trcf->trace);
+        trcf->trace = NULL;
+    }
+    return ok;
+}
+
+/* Insert into the newest cache. With INSERT_WALK a cache is added if a value was popped
+ * above MAX_OCCUPANCY (below it the popped value is dropped). With INSERT_BFS a failed
+ * search leaves the cache untouched and hh is placed in a new cache at any occupancy,
+ * so nothing is dropped. */
+static void trcf_insert(time_rotated_cache_filter_t * trcf, uint64_t hh[2]) {
+    time_rotated_cache_t * trc1 = trcf_get(trcf, -1);
+    if (trc_add_item(trc1, hh) == NULL) {
+        return;
+    }
+#if INSERT_MODE == INSERT_BFS
+    trcf_add_cache_best_guess(trcf);
+    trc_add_item(trcf_get(trcf, -1), hh);
+#else
+    if (((double)trc1->count / trc1->size_k) > MAX_OCCUPANCY) {
+        trcf_add_cache_best_guess(trcf);
+    }
+#endif
+}
+
+/* Add a pre-computed 128 bit hash, hh may be overwritten */
+void trcf_add_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]) {
+    if (trcf->trace != NULL) {
+        trace_append(trcf->trace, hh, TRACE_ADD, ct_gettime());
+    }
+    trcf_insert(trcf, hh);
+}
+
+int trcf_contains_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]) {
     int i;
-    HASH_128(s, len, hh);
+    if (trcf->trace != NULL) {
+        trace_append(trcf->trace, hh, TRACE_CONTAINS, ct_gettime());
+    }
     for (i=1; i < min(trcf->idx, trcf->siz) + 1; i++) { 
         if (trc_contains_item(trcf_get(trcf, -i), hh) == 1) {
             return 1;
@@ -287,21 +623,542 @@ int trcf_contains_item(time_rotated_cache_filter_t * trcf, const char *s, size_t
     return 0;
 }
 
-int trcf_add_if_new(time_rotated_cache_filter_t * trcf, const char *s, size_t len) {
-    uint64_t hh[2];
+int trcf_add_hash_if_new(time_rotated_cache_filter_t * trcf, uint64_t hh[2]) {
     int i;
-    HASH_128(s, len, hh);
-    time_rotated_cache_t * trc1;
+    if (trcf->trace != NULL) {
+        trace_append(trcf->trace, hh, TRACE_ADD_IF_NEW, ct_gettime());
+    }
     for (i=1; i < min(trcf->idx, trcf->siz) + 1; i++) { 
         if (trc_contains_item(trcf_get(trcf, -i), hh) == 1) {
             return 0;
         }
     }
-    trc1 = trcf_get(trcf, -1);
-    if ((trc_add_item(trc1, hh) != NULL ) && (((double)trc1->count / trc1->size_k) > MAX_OCCUPANCY)) {
-        trcf_add_cache_best_guess(trcf);
+    trcf_insert(trcf, hh);
+    return 1;
+}
+
+/* Remove hh from every cache, returns 1 if it was found in any */
+int trcf_remove_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]) {
+    int i, removed = 0;
+    if (trcf->trace != NULL) {
+        trace_append(trcf->trace, hh, TRACE_REMOVE, ct_gettime());
+    }
+    for (i=1; i < min(trcf->idx, trcf->siz) + 1; i++) { 
+        removed |= (trc_remove_item(trcf_get(trcf, -i), hh) > 0);
+    }
+    return removed;
+}
+
+void trcf_add_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len) {
+    uint64_t hh[2];
+    HASH_128(s, len, hh);
+    trcf_add_hash(trcf, hh);
+}
+
+int trcf_contains_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len)  {
+    uint64_t hh[2];
+    HASH_128(s, len, hh);
+    return trcf_contains_hash(trcf, hh);
+}
+
+int trcf_add_if_new(time_rotated_cache_filter_t * trcf, const char *s, size_t len) {
+    uint64_t hh[2];
+    HASH_128(s, len, hh);
+    return trcf_add_hash_if_new(trcf, hh);
+}
+
+int trcf_remove_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len) {
+    uint64_t hh[2];
+    HASH_128(s, len, hh);
+    return trcf_remove_hash(trcf, hh);
+}
+
+/**
+ * Fixed-Width Keys
+ * */
+
+void trcf_add_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key) {
+    uint64_t hh[2];
+    HASH_U64(key, hh);
+    trcf_add_hash(trcf, hh);
+}
+
+int trcf_contains_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key) {
+    uint64_t hh[2];
+    HASH_U64(key, hh);
+    return trcf_contains_hash(trcf, hh);
+}
+
+int trcf_add_if_new_u64(time_rotated_cache_filter_t * trcf, uint64_t key) {
+    uint64_t hh[2];
+    HASH_U64(key, hh);
+    return trcf_add_hash_if_new(trcf, hh);
+}
+
+int trcf_remove_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key) {
+    uint64_t hh[2];
+    HASH_U64(key, hh);
+    return trcf_remove_hash(trcf, hh);
+}
+
+void trcf_add_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]) {
+    uint64_t hh[2];
+    HASH_U128(key, hh);
+    trcf_add_hash(trcf, hh);
+}
+
+int trcf_contains_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]) {
+    uint64_t hh[2];
+    HASH_U128(key, hh);
+    return trcf_contains_hash(trcf, hh);
+}
+
+int trcf_add_if_new_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]) {
+    uint64_t hh[2];
+    HASH_U128(key, hh);
+    return trcf_add_hash_if_new(trcf, hh);
+}
+
+int trcf_remove_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]) {
+    uint64_t hh[2];
+    HASH_U128(key, hh);
+    return trcf_remove_hash(trcf, hh);
+}
+
+/**
+ * Batch Methods
+ * Keys are hashed BATCH_SIZ at a time and their slots in the newest cache
+ * prefetched before probing, out[i] receives the result for keys[i].
+ * */
+
+static void trcf_contains_hashes(time_rotated_cache_filter_t * trcf, uint64_t (*hh)[2], size_t n, int * out) {
+    size_t i;
+    for (i = 0; i < n; i++) {
+        cc_prefetch((cache_t *)trcf_get(trcf, -1), hh[i]);
+    }
+    for (i = 0; i < n; i++) {
+        out[i] = trcf_contains_hash(trcf, hh[i]);
+    }
+}
+
+static void trcf_add_hashes_if_new(time_rotated_cache_filter_t * trcf, uint64_t (*hh)[2], size_t n, int * out) {
+    size_t i;
+    for (i = 0; i < n; i++) {
+        cc_prefetch((cache_t *)trcf_get(trcf, -1), hh[i]);
+    }
+    for (i = 0; i < n; i++) {
+        out[i] = trcf_add_hash_if_new(trcf, hh[i]);
+    }
+}
+
+/* Removal visits every cache. It runs one cache at a time, prefetching only that
+ * cache's slots for the chunk, so no more than 2 * BATCH_SIZ lines are requested ahead */
+static void trcf_remove_hashes(time_rotated_cache_filter_t * trcf, uint64_t (*hh)[2], size_t n, int * out) {
+    time_rotated_cache_t * trc;
+    size_t i;
+    int j;
+    for (i = 0; i < n; i++) {
+        if (trcf->trace != NULL) {
+            trace_append(trcf->trace, hh[i], TRACE_REMOVE, ct_gettime());
+        }
+        out[i] = 0;
+    }
+    for (j=1; j < min(trcf->idx, trcf->siz) + 1; j++) {
+        trc = trcf_get(trcf, -j);
+        for (i = 0; i < n; i++) {
+            trc_prefetch(trc, hh[i]);
+        }
+        /* A compacted cache's run is found through its directory entry, prefetch it next */
+        for (i = 0; trc->dir != NULL && i < n; i++) {
+            __builtin_prefetch(&trc->state[trc->dir[trc_group(trc, hh[i][1])]]);
+        }
+        for (i = 0; i < n; i++) {
+            out[i] |= (trc_remove_item(trc, hh[i]) > 0);
+        }
+    }
+}
+
+/* Hash keys BATCH_SIZ at a time and apply op to each chunk of hashes */
+typedef void (*trcf_hashes_op_t)(time_rotated_cache_filter_t * trcf, uint64_t (*hh)[2], size_t n, int * out);
+
+static inline void trcf_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out, trcf_hashes_op_t op) {
+    uint64_t hh[BATCH_SIZ][2];
+    size_t base, i, m;
+    for (base = 0; base < n; base += BATCH_SIZ) {
+        m = min(BATCH_SIZ, n - base);
+        for (i = 0; i < m; i++) {
+            HASH_128(keys[base + i], lens[base + i], hh[i]);
+        }
+        op(trcf, hh, m, out + base);
+    }
+}
+
+static inline void trcf_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out, trcf_hashes_op_t op) {
+    uint64_t hh[BATCH_SIZ][2];
+    size_t base, i, m;
+    for (base = 0; base < n; base += BATCH_SIZ) {
+        m = min(BATCH_SIZ, n - base);
+        for (i = 0; i < m; i++) {
+            HASH_U64(keys[base + i], hh[i]);
+        }
+        op(trcf, hh, m, out + base);
+    }
+}
+
+static inline void trcf_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out, trcf_hashes_op_t op) {
+    uint64_t hh[BATCH_SIZ][2];
+    size_t base, i, m;
+    for (base = 0; base < n; base += BATCH_SIZ) {
+        m = min(BATCH_SIZ, n - base);
+        for (i = 0; i < m; i++) {
+            HASH_U128(keys[base + i], hh[i]);
+        }
+        op(trcf, hh, m, out + base);
+    }
+}
+
+void trcf_contains_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out) {
+    trcf_batch(trcf, keys, lens, n, out, trcf_contains_hashes);
+}
+
+void trcf_contains_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out) {
+    trcf_batch_u64(trcf, keys, n, out, trcf_contains_hashes);
+}
+
+void trcf_contains_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out) {
+    trcf_batch_u128(trcf, keys, n, out, trcf_contains_hashes);
+}
+
+void trcf_add_if_new_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out) {
+    trcf_batch(trcf, keys, lens, n, out, trcf_add_hashes_if_new);
+}
+
+void trcf_add_if_new_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out) {
+    trcf_batch_u64(trcf, keys, n, out, trcf_add_hashes_if_new);
+}
+
+void trcf_add_if_new_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out) {
+    trcf_batch_u128(trcf, keys, n, out, trcf_add_hashes_if_new);
+}
+
+void trcf_remove_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out) {
+    trcf_batch(trcf, keys, lens, n, out, trcf_remove_hashes);
+}
+
+void trcf_remove_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out) {
+    trcf_batch_u64(trcf, keys, n, out, trcf_remove_hashes);
+}
+
+void trcf_remove_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out) {
+    trcf_batch_u128(trcf, keys, n, out, trcf_remove_hashes);
+}
+
+/**
+ * Lookup Engine
+ * Lookups are advanced one memory access at a time, round robin, with the next
+ * access prefetched in between (AMAC), so single-key callers overlap their misses.
+ * Callbacks run from le_submit, le_poll or le_drain and must not call le_ methods.
+ * */
+
+enum {
+    LE_PROBE,   /* candidate slots of a sparse cache prefetched */
+    LE_DIR,     /* directory group of a compacted cache prefetched */
+    LE_RUN,     /* fingerprint run of a compacted cache prefetched */
+};
+
+lookup_engine_t * new_lookup_engine(time_rotated_cache_filter_t * trcf, void (*done)(void * tag, int found)) {
+    lookup_engine_t * le;
+    if ((le = (lookup_engine_t *)malloc(sizeof(lookup_engine_t))) == NULL) {
+        return NULL;
+    }
+    le->trcf = trcf;
+    le->done = done;
+    le->count = 0;
+    return le;
+}
+
+/* Completes all in-flight lookups */
+void remove_lookup_engine(lookup_engine_t * le) {
+    le_drain(le);
+    free(le);
+}
+
+/* Prefetch the first access into cache lk->gen, recording the check unless a
+ * probe of this cache was recorded before a restart */
+static void le_start(lookup_engine_t * le, lookup_t * lk) {
+    time_rotated_cache_t * trc = trcf_get(le->trcf, -lk->gen);
+    uint32_t abs = le->trcf->idx - lk->gen;
+    if (abs > lk->hi || abs < lk->lo) {
+        ct_append(trc->checks, ct_gettime());
+        lk->lo = min(lk->lo, abs);
+        lk->hi = max(lk->hi, abs);
+    }
+    if (trc->dir != NULL) {
+        lk->pos = trc_group(trc, lk->hh[1]);
+        __builtin_prefetch(&trc->dir[lk->pos]);
+        lk->stage = LE_DIR;
+    } else {
+        cc_prefetch((cache_t *)trc, lk->hh);
+        lk->stage = LE_PROBE;
+    }
+}
+
+/* Advance a lookup by one access, returns -1 while still in flight, else found */
+static int le_step(lookup_engine_t * le, lookup_t * lk) {
+    time_rotated_cache_filter_t * trcf = le->trcf;
+    time_rotated_cache_t * trc;
+    int found = 0;
+    uint32_t i;
+    /* A cache was added since, positions may be stale: start over from the newest */
+    if (lk->idx != trcf->idx) {
+        lk->idx = trcf->idx;
+        lk->gen = 1;
+        le_start(le, lk);
+        return -1;
+    }
+    trc = trcf_get(trcf, -lk->gen);
+    switch (lk->stage) {
+        case LE_PROBE:
+            found = cc_contains_item((cache_t *)trc, lk->hh);
+            break;
+        case LE_DIR:
+            lk->end = trc->dir[lk->pos + 1];
+            lk->pos = trc->dir[lk->pos];
+            __builtin_prefetch(&trc->state[lk->pos]);
+            lk->stage = LE_RUN;
+            return -1;
+        case LE_RUN:
+            for (i = lk->pos; i < lk->end && lk->hh[1] != 0; i++) {
+                if (trc->state[i] == lk->hh[1]) {
+                    found = 1;
+                    break;
+                }
+            }
+            break;
+    }
+    if (found) {
+        return 1;
+    }
+    if (++lk->gen > min(trcf->idx, trcf->siz)) {
+        return 0;
+    }
+    le_start(le, lk);
+    return -1;
+}
+
+/* Queue a lookup of a pre-computed hash. If the window is full, in-flight
+ * lookups are advanced until one completes. */
+void le_submit_hash(lookup_engine_t * le, uint64_t hh[2], void * tag) {
+    lookup_t * lk;
+    if (le->trcf->trace != NULL) {
+        trace_append(le->trcf->trace, hh, TRACE_CONTAINS, ct_gettime());
+    }
+    while (le->count == LOOKUP_WINDOW) {
+        le_poll(le);
+    }
+    lk = &le->window[le->count++];
+    lk->hh[0] = hh[0];
+    lk->hh[1] = hh[1];
+    lk->tag = tag;
+    lk->idx = le->trcf->idx;
+    lk->gen = 1;
+    /* Empty range, the first probe (idx - 1) extends it */
+    lk->lo = lk->idx;
+    lk->hi = lk->idx - 1;
+    le_start(le, lk);
+}
+
+void le_submit(lookup_engine_t * le, const char *s, size_t len, void * tag) {
+    uint64_t hh[2];
+    HASH_128(s, len, hh);
+    le_submit_hash(le, hh, tag);
+}
+
+void le_submit_u64(lookup_engine_t * le, uint64_t key, void * tag) {
+    uint64_t hh[2];
+    HASH_U64(key, hh);
+    le_submit_hash(le, hh, tag);
+}
+
+void le_submit_u128(lookup_engine_t * le, const uint64_t key[2], void * tag) {
+    uint64_t hh[2];
+    HASH_U128(key, hh);
+    le_submit_hash(le, hh, tag);
+}
+
+/* Advance every in-flight lookup by one access, returns the number completed */
+int le_poll(lookup_engine_t * le) {
+    uint32_t i = 0;
+    int found, completed = 0;
+    void * tag;
+    while (i < le->count) {
+        if ((found = le_step(le, &le->window[i])) < 0) {
+            i++;
+            continue;
+        }
+        tag = le->window[i].tag;
+        le->window[i] = le->window[--le->count];
+        le->done(tag, found);
+        completed++;
+    }
+    return completed;
+}
+
+void le_drain(lookup_engine_t * le) {
+    while (le->count > 0) {
+        le_poll(le);
+    }
+}
+
+/**
+ * Bulk Load
+ * */
+
+typedef struct {
+    cache_t * cc;
+    const char ** keys;
+    const size_t * lens;
+    uint64_t (*hh)[2];
+    uint8_t * pending;
+    size_t start;
+    size_t end;
+    uint64_t placed;
+    pthread_t thread;
+    int threaded;
+} bulk_part_t;
+
+/* Claim an empty candidate slot with a CAS. Returns 1 if fp was stored, -1 if the
+ * slot already held fp, 0 if it holds another fingerprint */
+static inline int cc_claim_slot(cache_t * cc, uint64_t ind, uint64_t fp) {
+    uint64_t expected = 0;
+    if (__atomic_compare_exchange_n(&cc->state[ind], &expected, fp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    return -(expected == fp);
+}
+
+/* Hash a range of keys and place those with a free candidate slot, mark the rest pending.
+ * Placements are counted locally, parts share cache lines */
+static void * bulk_load_part(void * arg) {
+    bulk_part_t * part = (bulk_part_t *)arg;
+    cache_t * cc = part->cc;
+    uint64_t ind, fp, placed = 0;
+    size_t i;
+    int claimed;
+    for (i = part->start; i < part->end; i++) {
+        HASH_128(part->keys[i], part->lens[i], part->hh[i]);
+        ind = part->hh[i][0] % cc->size_k;
+        fp = part->hh[i][1];
+        if ((claimed = cc_claim_slot(cc, ind, fp)) == 0) {
+            claimed = cc_claim_slot(cc, cc_alt_index(cc, ind, fp), fp);
+        }
+        placed += (claimed > 0);
+        part->pending[i] = (claimed == 0);
+    }
+    part->placed = placed;
+    return NULL;
+}
+
+/* Place every key in trc, returns 0 if an eviction path search failed */
+static int bulk_fill(time_rotated_cache_t * trc, bulk_part_t * parts, int nthreads, uint64_t (*hh)[2], uint8_t * pending, size_t n) {
+    size_t i;
+    int t;
+    for (t = 0; t < nthreads; t++) {
+        parts[t].cc = (cache_t *)trc;
+        /* Part 0 runs on this thread, as does any part a thread can't be created for */
+        parts[t].threaded = (t > 0 && pthread_create(&parts[t].thread, NULL, bulk_load_part, &parts[t]) == 0);
+    }
+    for (t = 0; t < nthreads; t++) {
+        if (!parts[t].threaded) {
+            bulk_load_part(&parts[t]);
+        }
+    }
+    for (t = 0; t < nthreads; t++) {
+        if (parts[t].threaded) {
+            pthread_join(parts[t].thread, NULL);
+        }
+    }
+    for (t = 0; t < nthreads; t++) {
+        trc->count += parts[t].placed;
+    }
+    for (i = 0; i < n; i++) {
+        if (pending[i] && cc_add_item_bfs((cache_t *)trc, hh[i]) != NULL) {
+            return 0;
+        }
     }
     return 1;
 }
 
+/* Bulk load into at most half of free_memory, leaving the other half for the next
+ * generation, which starts at the bulk cache's size. Returns NULL if it doesn't fit */
+static time_rotated_cache_t * trc_bulk(const char ** keys, const size_t * lens, size_t n, int nthreads, uint64_t free_memory) {
+    time_rotated_cache_t * trc = NULL;
+    bulk_part_t * parts;
+    uint64_t (*hh)[2];
+    uint8_t * pending;
+    uint64_t size_k = max((uint64_t)(n * BULK_SLACK / MAX_OCCUPANCY) + 1, MIN_SIZE_K);
+    uint64_t max_size_k = free_memory / (2 * RESERVED_SLOT_BYTES);
+    int t;
+    if (size_k > max_size_k) {
+        return NULL;
+    }
+    if (nthreads <= 0) {
+        nthreads = max(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    }
+    hh = malloc(n * sizeof(*hh));
+    pending = malloc(n);
+    parts = malloc(nthreads * sizeof(bulk_part_t));
+    if (hh != NULL && pending != NULL && parts != NULL) {
+        for (t = 0; t < nthreads; t++) {
+            parts[t] = (bulk_part_t){ NULL, keys, lens, hh, pending, n * t / nthreads, n * (t + 1) / nthreads, 0 };
+        }
+        while ((trc = new_time_rotated_cache(size_k)) != NULL && !bulk_fill(trc, parts, nthreads, hh, pending, n)) {
+            remove_time_rotated_cache(trc);
+            trc = NULL;
+            if ((size_k += size_k / 4) > max_size_k) {
+                break;
+            }
+        }
+    }
+    free(hh);
+    free(pending);
+    free(parts);
+    return trc;
+}
+
+/* Build a single cache holding n keys at MAX_OCCUPANCY.
+ * Keys are hashed and placed in parallel across nthreads (<= 0 for one per cpu),
+ * each claiming free candidate slots with a CAS; keys that need evictions are
+ * then inserted sequentially. If one can't be placed the cache is rebuilt 25%
+ * larger, so no key is dropped. The result answers trc_contains_item the same
+ * as sequential inserts of the same keys. Returns NULL if the cache, and a next
+ * generation of the same size, would not fit in MAX_MEMORY. */
+time_rotated_cache_t * new_time_rotated_cache_bulk(const char ** keys, const size_t * lens, size_t n, int nthreads) {
+    return trc_bulk(keys, lens, n, nthreads, MAX_MEMORY);
+}
 
+/* Append a cache bulk loaded with n keys as the newest cache */
+int trcf_add_bulk(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int nthreads) {
+    time_rotated_cache_t * trc;
+    uint64_t hh[2];
+    size_t i;
+    if ((trc = trc_bulk(keys, lens, n, nthreads, trcf_free_memory(trcf))) == NULL) {
+        return 0;
+    }
+    trcf_push_cache(trcf, trc);
+    if (trcf->trace != NULL) {
+        for (i = 0; i < n; i++) {
+            HASH_128(keys[i], lens[i], hh);
+            trace_append(trcf->trace, hh, TRACE_ADD, ct_gettime());
+        }
+    }
+    return 1;
+}
+
+time_rotated_cache_filter_t * new_time_rotated_cache_filter_bulk(const char ** keys, const size_t * lens, size_t n, int nthreads) {
+    time_rotated_cache_filter_t * trcf; 
+    if ((trcf = (time_rotated_cache_filter_t *)malloc(sizeof(time_rotated_cache_filter_t))) == NULL) {
+        return NULL;
+    }
+    return init_time_rotated_cache_filter(trcf, new_time_rotated_cache_bulk(keys, lens, n, nthreads));
+}
@@ -8,6 +8,8 @@
 #include "trcfconstants.h"
 #define TRCFCONSTANTS
 #endif
+#include "trcftrace.h"
+#include "trcfapi.h"
 
 #define SIZE_N 0xffffffffffffffffLL
 
@@ -34,17 +36,43 @@ typedef struct {
     uint64_t array[CHECK_TIMES_SIZ];
 } check_times_t;
 
-typedef struct {
+struct time_rotated_cache {
     cache_t; 
     check_times_t * checks;
     uint64_t creation_time;
-} time_rotated_cache_t; 
+    /* Set once compacted: state holds fingerprints grouped by their top dir_bits bits,
+     * group g being state[dir[g]] .. state[dir[g+1]-1] */
+    uint32_t * dir;
+    uint32_t dir_bits;
+}; 
 
-typedef struct {
+struct time_rotated_cache_filter {
     uint32_t idx;
     uint32_t siz;
     time_rotated_cache_t * caches[MAX_CACHES]; //correct?
-} time_rotated_cache_filter_t; 
+    trace_t * trace;
+}; 
+
+/* In-flight lookup of a lookup_engine_t */
+typedef struct {
+    uint64_t hh[2];
+    void * tag;
+    uint32_t idx;       /* trcf->idx when probing (re)started */
+    uint32_t gen;       /* cache being probed, 1 = newest */
+    uint32_t lo;        /* caches trcf->idx - gen in [lo, hi] have had this check recorded */
+    uint32_t hi;
+    uint32_t stage;
+    uint32_t pos;
+    uint32_t end;
+} lookup_t;
+
+/* Interleaves up to LOOKUP_WINDOW single-key lookups, see le_submit */
+struct lookup_engine {
+    time_rotated_cache_filter_t * trcf;
+    void (*done)(void * tag, int found);
+    uint32_t count;
+    lookup_t window[LOOKUP_WINDOW];
+};
 
 /** 
  * Cuckoo-Cache Methods
@@ -52,6 +80,7 @@ typedef struct {
 int cc_contains_item(cache_t * cc, uint64_t hh[]);
 int cc_remove_item(cache_t * cc, uint64_t hh[]);
 uint64_t * cc_add_item(cache_t * cc, uint64_t hh[]);
+uint64_t * cc_add_item_bfs(cache_t * cc, uint64_t hh[]);
 cache_t * new_cache(uint64_t size_k); 
 void remove_cache(cache_t * cc);
 
@@ -62,22 +91,15 @@ int trc_contains_item(time_rotated_cache_t * trc, uint64_t hh[2]);
 int trc_remove_item(time_rotated_cache_t * trc, uint64_t hh[2]);
 uint64_t * trc_add_item(time_rotated_cache_t * trc, uint64_t hh[2]);
 time_rotated_cache_t * new_time_rotated_cache(uint64_t size_k);
+time_rotated_cache_t * new_time_rotated_cache_bulk(const char ** keys, const size_t * lens, size_t n, int nthreads);
 void remove_time_rotated_cache(time_rotated_cache_t * trc);
 double trc_checks_per_count_second(time_rotated_cache_t * trc);
+int trc_compact(time_rotated_cache_t * trc);
+uint64_t trc_memory(time_rotated_cache_t * trc);
 
-/** 
- * Time-Rotated-Cache-Filter Methods
+/**
+ * Time-Rotated-Cache-Filter Methods, see trcfapi.h for the public API
  * */
-void trcf_add_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
-int trcf_contains_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
-int trcf_remove_item(time_rotated_cache_t * trcf,  const char *s, size_t len);
-int trcf_add_if_new(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
-time_rotated_cache_filter_t * new_time_rotated_cache_filter(uint64_t size_k);
-void remove_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf);
-void trcf_add_cache_best_guess(time_rotated_cache_filter_t * trcf);
-uint64_t trcf_total_size_k(time_rotated_cache_filter_t * trcf);
-void trcf_add_stash(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
-
-uint64_t ct_get(check_times_t * ct, int i);
 time_rotated_cache_t * trcf_get(time_rotated_cache_filter_t * trcf, int i);
+uint64_t ct_get(check_times_t * ct, int i);
 
@@ -0,0 +1,354 @@
+#ifndef _TRCF_HPP_
+#define _TRCF_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "murmur.h"
+#ifndef TRCFCONSTANTS
+#include "trcfconstants.h"
+#define TRCFCONSTANTS
+#endif
+
+/**
+ * Header-only C++ front-end for the Time-Rotated Cache Filter.
+ * Same cuckoo scheme and insertion (INSERT_MODE) as trcf.c, with the fingerprint
+ * width, bucket width (Ways), hash and constants fixed at compile time.
+ * */
+
+namespace trcf {
+
+using hash128 = std::array<uint64_t, 2>;
+
+/* Murmur3 x64 128 with SALT_CONSTANT, hashes identically to the C library */
+struct murmur3_128 {
+    hash128 operator()(std::string_view key) const noexcept {
+        hash128 hh;
+        MurmurHash3_x64_128(key.data(), (int)key.size(), SALT_CONSTANT, hh.data());
+        return hh;
+    }
+};
+
+/* Constants from trcfconstants.h, derive and shadow members to override */
+struct default_config {
+    static constexpr unsigned max_tries = MAX_TRIES;
+    static constexpr unsigned max_caches = MAX_CACHES;
+    static constexpr double max_occupancy = MAX_OCCUPANCY;
+    static constexpr uint64_t min_size_k = MIN_SIZE_K;
+    /* Round size_k up to a power of two and index with a mask instead of % */
+    static constexpr bool power_of_two = false;
+    /* Keys hashed and prefetched ahead of probing in the batch API */
+    static constexpr std::size_t batch_size = 16;
+    /* Insert by breadth-first eviction path search (as INSERT_BFS in trcf.c) or the walk */
+    static constexpr bool insert_bfs = (INSERT_MODE == INSERT_BFS);
+    static constexpr unsigned bfs_max_depth = BFS_MAX_DEPTH;
+};
+
+/**
+ * Cuckoo-Cache: size_k buckets of Ways fingerprints, 0 marks an empty slot.
+ * */
+template <typename Fingerprint, unsigned Ways, typename Config>
+class cache {
+    static_assert(std::is_unsigned_v<Fingerprint>, "Fingerprint must be an unsigned integer");
+    static_assert(Ways > 0, "Ways must be at least 1");
+public:
+    cache() = default;
+    explicit cache(uint64_t size_k)
+        : size_k_(round_size(size_k)),
+          state_(new Fingerprint[size_k_ * Ways]()) {}
+    cache(cache &&) noexcept = default;
+    cache & operator=(cache &&) noexcept = default;
+    cache(const cache &) = delete;
+    cache & operator=(const cache &) = delete;
+
+    static Fingerprint fingerprint(const hash128 & hh) noexcept {
+        Fingerprint fp = static_cast<Fingerprint>(hh[1]);
+        return fp ? fp : 1;
+    }
+
+    bool contains(const hash128 & hh) const noexcept {
+        Fingerprint fp = fingerprint(hh);
+        uint64_t ind = index(hh[0]);
+        return bucket_has(bucket(ind), fp) || bucket_has(bucket(alt_index(ind, fp)), fp);
+    }
+
+    void prefetch(const hash128 & hh) const noexcept {
+        uint64_t ind = index(hh[0]);
+        __builtin_prefetch(bucket(ind));
+        __builtin_prefetch(bucket(alt_index(ind, fingerprint(hh))));
+    }
+
+    /* Returns false if hh could not be placed. With Config::insert_bfs the cache is
+     * then unchanged, with the walk a fingerprint was knocked out after max_tries kicks */
+    bool add(const hash128 & hh) noexcept {
+        if constexpr (Config::insert_bfs) {
+            return add_bfs(hh);
+        } else {
+            return add_walk(hh);
+        }
+    }
+
+    bool add_walk(const hash128 & hh) noexcept {
+        Fingerprint fp = fingerprint(hh);
+        uint64_t ind = index(hh[0]);
+        for (unsigned i = 0; i < Config::max_tries; i++) {
+            Fingerprint * b = bucket(ind);
+            for (unsigned w = 0; w < Ways; w++) {
+                if (b[w] == fp) {
+                    return true;
+                }
+            }
+            for (unsigned w = 0; w < Ways; w++) {
+                if (b[w] == 0) {
+                    b[w] = fp;
+                    count_++;
+                    return true;
+                }
+            }
+            std::swap(b[i % Ways], fp);
+            ind = alt_index(ind, fp);
+        }
+        return false;
+    }
+
+    /* Breadth-first search from both candidate buckets for the shortest eviction path to
+     * an empty slot, moving fingerprints only once one is found. For Ways = 1 this is the
+     * search cc_add_item_bfs does. Returns false, cache unchanged, if none is found. */
+    bool add_bfs(const hash128 & hh) noexcept {
+        struct node {
+            uint64_t ind;
+            unsigned parent;    /* node whose fingerprint at way moves into ind */
+            unsigned way;
+            unsigned depth;
+        };
+        static constexpr unsigned no_parent = ~0u;
+        static constexpr unsigned max_nodes = 2 * Config::bfs_max_depth * Ways;
+        node q[max_nodes];
+        unsigned head = 0, tail = 0;
+        Fingerprint fp = fingerprint(hh);
+        uint64_t ind = index(hh[0]);
+        if (bucket_has(bucket(ind), fp) || bucket_has(bucket(alt_index(ind, fp)), fp)) {
+            return true;
+        }
+        q[tail++] = {ind, no_parent, 0, 0};
+        q[tail++] = {alt_index(ind, fp), no_parent, 0, 0};
+        while (head < tail) {
+            unsigned n = head++;
+            Fingerprint * b = bucket(q[n].ind);
+            for (unsigned w = 0; w < Ways; w++) {
+                if (b[w] != 0) {
+                    continue;
+                }
+                /* Shift each fingerprint on the path into the slot freed after it */
+                for (unsigned free_way = w; ; n = q[n].parent) {
+                    if (q[n].parent == no_parent) {
+                        bucket(q[n].ind)[free_way] = fp;
+                        count_++;
+                        return true;
+                    }
+                    bucket(q[n].ind)[free_way] = bucket(q[q[n].parent].ind)[q[n].way];
+                    free_way = q[n].way;
+                }
+            }
+            if (q[n].depth + 1 == Config::bfs_max_depth) {
+                continue;
+            }
+            for (unsigned w = 0; w < Ways && tail < max_nodes; w++) {
+                uint64_t next = alt_index(q[n].ind, b[w]);
+                bool cycle = false;
+                for (unsigned a = n; a != no_parent && !cycle; a = q[a].parent) {
+                    cycle = (q[a].ind == next);
+                }
+                if (!cycle) {
+                    q[tail++] = {next, n, w, q[n].depth + 1};
+                }
+            }
+        }
+        return false;
+    }
+
+    uint64_t size_k() const noexcept { return size_k_; }
+    uint64_t count() const noexcept { return count_; }
+    double occupancy() const noexcept { return (double)count_ / (size_k_ * Ways); }
+    std::size_t memory_bytes() const noexcept { return size_k_ * Ways * sizeof(Fingerprint); }
+
+private:
+    static uint64_t round_size(uint64_t size_k) noexcept {
+        size_k = std::max<uint64_t>(size_k, 1);
+        if constexpr (Config::power_of_two) {
+            return std::bit_ceil(size_k);
+        } else {
+            return size_k;
+        }
+    }
+
+    uint64_t index(uint64_t h) const noexcept {
+        if constexpr (Config::power_of_two) {
+            return h & (size_k_ - 1);
+        } else {
+            return h % size_k_;
+        }
+    }
+
+    /* alt_index(alt_index(ind, fp), fp) == ind, as cc_alt_index in trcf.c */
+    uint64_t alt_index(uint64_t ind, Fingerprint fp) const noexcept {
+        if constexpr (Config::power_of_two) {
+            return ((uint64_t)fp - ind) & (size_k_ - 1);
+        } else {
+            return ((uint64_t)fp % size_k_ + size_k_ - ind) % size_k_;
+        }
+    }
+
+    Fingerprint * bucket(uint64_t ind) const noexcept {
+        return &state_[ind * Ways];
+    }
+
+    static bool bucket_has(const Fingerprint * b, Fingerprint fp) noexcept {
+        bool found = false;
+        for (unsigned w = 0; w < Ways; w++) {
+            found |= (b[w] == fp);
+        }
+        return found;
+    }
+
+    uint64_t size_k_ = 0;
+    uint64_t count_ = 0;
+    std::unique_ptr<Fingerprint[]> state_;
+};
+
+/**
+ * Time-Rotated-Cache-Filter: ring of up to Config::max_caches generations,
+ * searched newest first. A new generation is added when an insert knocks a
+ * fingerprint out of the newest one and it is above Config::max_occupancy.
+ * */
+template <typename Fingerprint = uint64_t, unsigned Ways = 1,
+          typename Hash = murmur3_128, typename Config = default_config>
+class filter {
+public:
+    using cache_type = cache<Fingerprint, Ways, Config>;
+
+    explicit filter(uint64_t size_k, Hash hash = Hash())
+        : hash_(std::move(hash)) {
+        rotate(size_k);
+    }
+    filter(filter &&) noexcept = default;
+    filter & operator=(filter &&) noexcept = default;
+    filter(const filter &) = delete;
+    filter & operator=(const filter &) = delete;
+
+    void add(std::string_view key) { add_hash(hash_(key)); }
+    bool contains(std::string_view key) const { return contains_hash(hash_(key)); }
+    bool add_if_new(std::string_view key) { return add_hash_if_new(hash_(key)); }
+
+    /* As trcf_insert: with insert_bfs an item that can't be placed goes to a new
+     * generation, with the walk one is only added above max_occupancy */
+    void add_hash(const hash128 & hh) {
+        cache_type & trc1 = get(1);
+        if (trc1.add(hh)) {
+            return;
+        }
+        if constexpr (Config::insert_bfs) {
+            rotate(trc1.size_k());
+            get(1).add(hh);
+        } else if (trc1.occupancy() > Config::max_occupancy) {
+            rotate(trc1.size_k());
+        }
+    }
+
+    bool contains_hash(const hash128 & hh) const noexcept {
+        for (unsigned i = 1; i <= generations(); i++) {
+            if (get(i).contains(hh)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool add_hash_if_new(const hash128 & hh) {
+        if (contains_hash(hh)) {
+            return false;
+        }
+        add_hash(hh);
+        return true;
+    }
+
+    /* Batch lookup, out[i] = contains(keys[i]) */
+    void contains(std::span<const std::string_view> keys, std::span<bool> out) const {
+        hash128 hh[Config::batch_size];
+        for (std::size_t base = 0; base < keys.size(); base += Config::batch_size) {
+            std::size_t n = std::min(Config::batch_size, keys.size() - base);
+            for (std::size_t i = 0; i < n; i++) {
+                hh[i] = hash_(keys[base + i]);
+                get(1).prefetch(hh[i]);
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                out[base + i] = contains_hash(hh[i]);
+            }
+        }
+    }
+
+    /* Batch insert, out[i] = add_if_new(keys[i]) */
+    void add_if_new(std::span<const std::string_view> keys, std::span<bool> out) {
+        hash128 hh[Config::batch_size];
+        for (std::size_t base = 0; base < keys.size(); base += Config::batch_size) {
+            std::size_t n = std::min(Config::batch_size, keys.size() - base);
+            for (std::size_t i = 0; i < n; i++) {
+                hh[i] = hash_(keys[base + i]);
+                get(1).prefetch(hh[i]);
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                out[base + i] = add_hash_if_new(hh[i]);
+            }
+        }
+    }
+
+    /* Generation i = 1 is the newest, i = generations() the oldest */
+    const cache_type & get(unsigned i) const noexcept {
+        return caches_[(idx_ - i) % Config::max_caches];
+    }
+    cache_type & get(unsigned i) noexcept {
+        return caches_[(idx_ - i) % Config::max_caches];
+    }
+
+    unsigned generations() const noexcept { return std::min<unsigned>(idx_, Config::max_caches); }
+    unsigned rotations() const noexcept { return idx_ - 1; }
+
+    uint64_t total_size_k() const noexcept {
+        uint64_t total = 0;
+        for (unsigned i = 1; i <= generations(); i++) {
+            total += get(i).size_k();
+        }
+        return total;
+    }
+
+    std::size_t memory_bytes() const noexcept {
+        std::size_t total = 0;
+        for (unsigned i = 1; i <= generations(); i++) {
+            total += get(i).memory_bytes();
+        }
+        return total;
+    }
+
+private:
+    /* Replace the oldest generation once the ring is full */
+    void rotate(uint64_t size_k) {
+        caches_[idx_ % Config::max_caches] = cache_type(std::max(size_k, Config::min_size_k));
+        idx_++;
+    }
+
+    Hash hash_;
+    unsigned idx_ = 0;
+    std::array<cache_type, Config::max_caches> caches_;
+};
+
+} // namespace trcf
+
+#endif // _TRCF_HPP_
@@ -0,0 +1,87 @@
+#ifndef _TRCFAPI_H_
+#define _TRCFAPI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Public Time-Rotated-Cache-Filter API. The types are opaque here, so this header
+ * compiles as C and C++ without -fms-extensions; trcf.h defines them.
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct time_rotated_cache time_rotated_cache_t;
+typedef struct time_rotated_cache_filter time_rotated_cache_filter_t;
+typedef struct lookup_engine lookup_engine_t;
+
+/**
+ * Time-Rotated-Cache-Filter Methods
+ * */
+void trcf_add_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
+int trcf_contains_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
+int trcf_remove_item(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
+int trcf_add_if_new(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
+time_rotated_cache_filter_t * new_time_rotated_cache_filter(uint64_t size_k);
+time_rotated_cache_filter_t * new_time_rotated_cache_filter_bulk(const char ** keys, const size_t * lens, size_t n, int nthreads);
+int trcf_add_bulk(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int nthreads);
+void remove_time_rotated_cache_filter(time_rotated_cache_filter_t * trcf);
+void trcf_add_cache_best_guess(time_rotated_cache_filter_t * trcf);
+uint64_t trcf_total_size_k(time_rotated_cache_filter_t * trcf);
+uint64_t trcf_total_memory(time_rotated_cache_filter_t * trcf);
+void trcf_add_stash(time_rotated_cache_filter_t * trcf, const char *s, size_t len);
+void trcf_add_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]);
+int trcf_contains_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]);
+int trcf_add_hash_if_new(time_rotated_cache_filter_t * trcf, uint64_t hh[2]);
+int trcf_remove_hash(time_rotated_cache_filter_t * trcf, uint64_t hh[2]);
+
+/**
+ * Fixed-Width Key Methods
+ * */
+void trcf_add_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key);
+int trcf_contains_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key);
+int trcf_add_if_new_u64(time_rotated_cache_filter_t * trcf, uint64_t key);
+int trcf_remove_item_u64(time_rotated_cache_filter_t * trcf, uint64_t key);
+void trcf_add_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]);
+int trcf_contains_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]);
+int trcf_add_if_new_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]);
+int trcf_remove_item_u128(time_rotated_cache_filter_t * trcf, const uint64_t key[2]);
+
+/**
+ * Batch Methods, out[i] is the result for keys[i]
+ * */
+void trcf_contains_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out);
+void trcf_contains_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out);
+void trcf_contains_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out);
+void trcf_add_if_new_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out);
+void trcf_add_if_new_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out);
+void trcf_add_if_new_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out);
+void trcf_remove_batch(time_rotated_cache_filter_t * trcf, const char ** keys, const size_t * lens, size_t n, int * out);
+void trcf_remove_batch_u64(time_rotated_cache_filter_t * trcf, const uint64_t * keys, size_t n, int * out);
+void trcf_remove_batch_u128(time_rotated_cache_filter_t * trcf, const uint64_t (*keys)[2], size_t n, int * out);
+
+/**
+ * Lookup Engine Methods
+ * */
+lookup_engine_t * new_lookup_engine(time_rotated_cache_filter_t * trcf, void (*done)(void * tag, int found));
+void remove_lookup_engine(lookup_engine_t * le);
+void le_submit(lookup_engine_t * le, const char *s, size_t len, void * tag);
+void le_submit_u64(lookup_engine_t * le, uint64_t key, void * tag);
+void le_submit_u128(lookup_engine_t * le, const uint64_t key[2], void * tag);
+void le_submit_hash(lookup_engine_t * le, uint64_t hh[2], void * tag);
+int le_poll(lookup_engine_t * le);
+void le_drain(lookup_engine_t * le);
+
+int trcf_trace_start(time_rotated_cache_filter_t * trcf, const char * path);
+int trcf_trace_stop(time_rotated_cache_filter_t * trcf);
+
+uint64_t ct_gettime(void);
+void trcf_set_clock(uint64_t (*clock)(void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _TRCFAPI_H_
@@ -1,20 +1,71 @@
 /**
  * Define Time-Rotated-Cache-Filter Constants
+ * Each constant may be overridden at compile time, e.g. -DMAX_TRIES=16
  * */
- 
+
 /* Number of iterations before replace on insert*/
+#ifndef MAX_TRIES
 #define MAX_TRIES 8
+#endif
+/* Insertion: INSERT_WALK (random walk of MAX_TRIES kicks) or INSERT_BFS (shortest eviction path search) */
+#define INSERT_WALK 0
+#define INSERT_BFS 1
+#ifndef INSERT_MODE
+#define INSERT_MODE INSERT_BFS
+#endif
+/* Max eviction path length searched from each candidate index by INSERT_BFS */
+#ifndef BFS_MAX_DEPTH
+#define BFS_MAX_DEPTH 32
+#endif
 /* Max filter memory (total of all caches) in bytes */
+#ifndef MAX_MEMORY
 #define MAX_MEMORY 10*1024*1024
+#endif
 /* Minimum assignable cache size */
+#ifndef MIN_SIZE_K
 #define MIN_SIZE_K 512
+#endif
 /* Maximum number of caches in filter */
+#ifndef MAX_CACHES
 #define MAX_CACHES 5
+#endif
 /* Add new cache to filter if occupancy exceeds this ratio */
+#ifndef MAX_OCCUPANCY
 #define MAX_OCCUPANCY 0.5
+#endif
+/* Bulk loaded caches are sized to n * BULK_SLACK / MAX_OCCUPANCY so every key finds an eviction path */
+#ifndef BULK_SLACK
+#define BULK_SLACK 1.1
+#endif
 /* Size of contains_item timestamp array per cache */
+#ifndef CHECK_TIMES_SIZ
 #define CHECK_TIMES_SIZ 2<<9
+#endif
+/* Compact caches into a dense read-only encoding once they are no longer the newest */
+#ifndef COMPACT_COLD
+#define COMPACT_COLD 1
+#endif
+/* Average fingerprints per directory group in a compacted cache */
+#ifndef COMPACT_GROUP
+#define COMPACT_GROUP 4
+#endif
 /* Max cache rescale on trcf_best_guess_size */
+#ifndef MAX_RESCALE
 #define MAX_RESCALE 4
+#endif
 /* Murmur Hash Seed */
+#ifndef SALT_CONSTANT
 #define SALT_CONSTANT 0x97c29b3a
+#endif
+/* Keys hashed and prefetched ahead of probing by the batch methods */
+#ifndef BATCH_SIZ
+#define BATCH_SIZ 16
+#endif
+/* Lookups kept in flight by a lookup engine */
+#ifndef LOOKUP_WINDOW
+#define LOOKUP_WINDOW 8
+#endif
+/* Number of trace records buffered before a write */
+#ifndef TRACE_BUF_SIZ
+#define TRACE_BUF_SIZ 4096
+#endif
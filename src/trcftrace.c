@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include "trcftrace.h"
+
+/**
+ * Trace Methods
+ * */
+
+/* Create a trace file for writing, records are buffered TRACE_BUF_SIZ at a time */
+trace_t * new_trace(const char * path, uint64_t start_time, uint64_t size_k) {
+    trace_t * tr;
+    trace_header_t th = { TRACE_MAGIC, TRACE_VERSION, start_time, size_k };
+    if ((tr = (trace_t *)malloc(sizeof(trace_t))) == NULL) {
+        return NULL;
+    }
+    if ((tr->fp = fopen(path, "wb")) == NULL) {
+        free(tr);
+        return NULL;
+    }
+    if (fwrite(&th, sizeof(trace_header_t), 1, tr->fp) != 1) {
+        fclose(tr->fp);
+        free(tr);
+        return NULL;
+    }
+    tr->start_time = start_time;
+    tr->size_k = size_k;
+    tr->idx = 0;
+    tr->error = 0;
+    return tr;
+}
+
+/* Open an existing trace file for reading with trace_read */
+trace_t * open_trace(const char * path) {
+    trace_t * tr;
+    trace_header_t th;
+    if ((tr = (trace_t *)malloc(sizeof(trace_t))) == NULL) {
+        return NULL;
+    }
+    if ((tr->fp = fopen(path, "rb")) == NULL) {
+        free(tr);
+        return NULL;
+    }
+    if (fread(&th, sizeof(trace_header_t), 1, tr->fp) != 1 ||
+            th.magic != TRACE_MAGIC || th.version != TRACE_VERSION) {
+        fclose(tr->fp);
+        free(tr);
+        return NULL;
+    }
+    tr->start_time = th.start_time;
+    tr->size_k = th.size_k;
+    tr->idx = 0;
+    tr->error = 0;
+    return tr;
+}
+
+/* Write out buffered records, returns 0 on a short write. Failures are also
+ * kept in tr->error for remove_trace to report */
+int trace_flush(trace_t * tr) {
+    uint32_t n = tr->idx;
+    tr->idx = 0;
+    if (fwrite(tr->buf, sizeof(trace_record_t), n, tr->fp) != n) {
+        tr->error = 1;
+    }
+    return !tr->error;
+}
+
+size_t trace_read(trace_t * tr, trace_record_t * out, size_t n) {
+    return fread(out, sizeof(trace_record_t), n, tr->fp);
+}
+
+/* Flush (if writing) and close the trace, returns 0 if any write failed */
+int remove_trace(trace_t * tr) {
+    int ok;
+    if (tr->idx > 0) {
+        trace_flush(tr);
+    }
+    ok = (fclose(tr->fp) == 0 && !tr->error);
+    free(tr);
+    return ok;
+}
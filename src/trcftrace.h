@@ -0,0 +1,68 @@
+#ifndef _TRCFTRACE_H_
+#define _TRCFTRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef TRCFCONSTANTS
+#include "trcfconstants.h"
+#define TRCFCONSTANTS
+#endif
+
+/* "TRCF" little-endian, records are written in native byte order */
+#define TRACE_MAGIC 0x46435254
+#define TRACE_VERSION 2
+
+/* Operation recorded in the low 2 bits of trace_record_t.tv */
+enum {
+    TRACE_ADD,
+    TRACE_CONTAINS,
+    TRACE_ADD_IF_NEW,
+    TRACE_REMOVE,
+};
+
+#define TRACE_OP(r)   ((int)((r)->tv & 3))
+#define TRACE_TIME(r) ((r)->tv >> 2)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t start_time;
+    uint64_t size_k;    /* size_k of the newest cache when recording started */
+} trace_header_t;
+
+/* 24 bytes per operation: 128 bit hash, (nanoseconds since start << 2) | op */
+typedef struct {
+    uint64_t hh[2];
+    uint64_t tv;
+} trace_record_t;
+
+typedef struct {
+    FILE * fp;
+    uint64_t start_time;
+    uint64_t size_k;
+    uint32_t idx;
+    int error;          /* set once a write has failed */
+    trace_record_t buf[TRACE_BUF_SIZ];
+} trace_t;
+
+/**
+ * Trace Methods
+ * */
+trace_t * new_trace(const char * path, uint64_t start_time, uint64_t size_k);
+trace_t * open_trace(const char * path);
+int trace_flush(trace_t * tr);
+size_t trace_read(trace_t * tr, trace_record_t * out, size_t n);
+int remove_trace(trace_t * tr);
+
+static inline void trace_append(trace_t * tr, uint64_t hh[2], int op, uint64_t tv) {
+    trace_record_t * r = &tr->buf[tr->idx++];
+    r->hh[0] = hh[0];
+    r->hh[1] = hh[1];
+    r->tv = ((tv - tr->start_time) << 2) | op;
+    if (tr->idx == TRACE_BUF_SIZ) {
+        trace_flush(tr);
+    }
+}
+
+#endif // _TRCFTRACE_H_